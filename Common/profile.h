@@ -0,0 +1,218 @@
+#pragma once
+
+// Opt-in phase profiler shared by the days (--profile). Each phase of a
+// run is measured with Linux perf_event_open counters -- cycles,
+// instructions, cache references and misses, branches and branch misses,
+// dTLB loads and load misses -- and a table with IPC and miss rates goes to
+// stderr at the end. Counters the kernel or CPU does not offer show as
+// "-"; if none can be opened (not Linux, a VM without a PMU,
+// perf_event_paranoid too strict) only wall and CPU time are reported.
+//
+// Counters follow threads started during a phase (inherit), but a thread's
+// counts only reach the phase in which it exits, so pools must be joined
+// inside the phase they work for. Multiplexed counters are scaled by the
+// fraction of the phase they were scheduled for.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class PhaseProfiler {
+public:
+    // A disabled profiler opens nothing and its calls do nothing.
+    explicit PhaseProfiler(bool enabled) : enabled_(enabled) {
+        fd_.fill(-1);
+        if (!enabled_) return;
+#ifdef __linux__
+        const std::array<std::pair<std::uint32_t, std::uint64_t>, kCounters> events = {{
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, tlb_event(PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+            {PERF_TYPE_HW_CACHE, tlb_event(PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        }};
+        for (int c = 0; c < kCounters; ++c) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = events[c].first;
+            attr.config = events[c].second;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1; // allowed at the default paranoid level
+            attr.exclude_hv = 1;
+            fd_[c] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fd_[c] == -1 && c == kCycles) {
+                unavailable_ = errno == EACCES || errno == EPERM ? "blocked by perf_event_paranoid"
+                               : errno == ENOENT || errno == ENODEV || errno == EOPNOTSUPP
+                                   ? "no PMU support"
+                                   : std::strerror(errno);
+            }
+        }
+#else
+        unavailable_ = "perf_event_open is Linux only";
+#endif
+    }
+
+    ~PhaseProfiler() {
+#ifdef __linux__
+        for (int fd : fd_) {
+            if (fd != -1) close(fd);
+        }
+#endif
+    }
+
+    PhaseProfiler(const PhaseProfiler&) = delete;
+    PhaseProfiler& operator=(const PhaseProfiler&) = delete;
+
+    // Ends the running phase, if any, and starts the one called name.
+    void phase(const char* name) {
+        if (!enabled_) return;
+        stop();
+        current_ = name;
+        running_ = true;
+        start_ = sample();
+    }
+
+    // Ends the running phase and prints one line per phase to stderr.
+    void report() {
+        if (!enabled_) return;
+        stop();
+        const bool counters = fd_[kCycles] != -1;
+        if (counters) {
+            std::fprintf(stderr, "%-16s %10s %10s %14s %14s %6s %11s %11s %11s\n", "phase",
+                         "wall ms", "cpu ms", "cycles", "instructions", "IPC", "cache miss",
+                         "branch miss", "dTLB miss");
+        } else {
+            std::fprintf(stderr, "Profile: no hardware counters (%s), timers only\n",
+                         unavailable_.c_str());
+            std::fprintf(stderr, "%-16s %10s %10s\n", "phase", "wall ms", "cpu ms");
+        }
+        for (const Phase& p : phases_) {
+            std::fprintf(stderr, "%-16s %10.3f %10.3f", p.name.c_str(), p.wall_ms, p.cpu_ms);
+            if (counters) {
+                std::fprintf(stderr, " %14s %14s %6s %11s %11s %11s",
+                             count(p, kCycles).c_str(), count(p, kInstructions).c_str(),
+                             ratio(p, kInstructions, kCycles, false).c_str(),
+                             ratio(p, kCacheMisses, kCacheRefs, true).c_str(),
+                             ratio(p, kBranchMisses, kBranches, true).c_str(),
+                             ratio(p, kTlbMisses, kTlbLoads, true).c_str());
+            }
+            std::fputc('\n', stderr);
+        }
+    }
+
+private:
+    enum Counter {
+        kCycles,
+        kInstructions,
+        kCacheRefs,
+        kCacheMisses,
+        kBranches,
+        kBranchMisses,
+        kTlbLoads,
+        kTlbMisses,
+        kCounters
+    };
+
+    // Counter readings: value, time enabled, time running
+    struct Sample {
+        std::array<std::array<std::uint64_t, 3>, kCounters> counters{};
+        std::chrono::steady_clock::time_point wall;
+        std::clock_t cpu = 0;
+    };
+
+    struct Phase {
+        std::string name;
+        double wall_ms = 0;
+        double cpu_ms = 0;
+        std::array<double, kCounters> delta{}; // -1 if not counted
+    };
+
+#ifdef __linux__
+    static std::uint64_t tlb_event(std::uint64_t result) {
+        return PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+    }
+#endif
+
+    Sample sample() const {
+        Sample s;
+#ifdef __linux__
+        for (int c = 0; c < kCounters; ++c) {
+            if (fd_[c] == -1 || read(fd_[c], s.counters[c].data(), sizeof(s.counters[c])) !=
+                                    static_cast<ssize_t>(sizeof(s.counters[c]))) {
+                s.counters[c] = {0, 0, 0};
+            }
+        }
+#endif
+        s.cpu = std::clock();
+        s.wall = std::chrono::steady_clock::now();
+        return s;
+    }
+
+    void stop() {
+        if (!running_) return;
+        running_ = false;
+        const Sample end = sample();
+        Phase p;
+        p.name = current_;
+        p.wall_ms = std::chrono::duration<double, std::milli>(end.wall - start_.wall).count();
+        p.cpu_ms = 1000.0 * static_cast<double>(end.cpu - start_.cpu) / CLOCKS_PER_SEC;
+        for (int c = 0; c < kCounters; ++c) {
+            const double value = static_cast<double>(end.counters[c][0] - start_.counters[c][0]);
+            const double enabled = static_cast<double>(end.counters[c][1] - start_.counters[c][1]);
+            const double ran = static_cast<double>(end.counters[c][2] - start_.counters[c][2]);
+            if (fd_[c] == -1) {
+                p.delta[c] = -1;
+            } else if (ran > 0) {
+                p.delta[c] = value * enabled / ran;
+            } else {
+                // Never scheduled: a phase too short to tell, or no PMU slot
+                p.delta[c] = value == 0 && enabled == 0 ? 0 : -1;
+            }
+        }
+        phases_.push_back(std::move(p));
+    }
+
+    static std::string count(const Phase& p, Counter c) {
+        if (p.delta[c] < 0) return "-";
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.0f", p.delta[c]);
+        return buf;
+    }
+
+    // num / den, as a percentage if percent is set; "-" if either is missing
+    static std::string ratio(const Phase& p, Counter num, Counter den, bool percent) {
+        if (p.delta[num] < 0 || p.delta[den] <= 0) return "-";
+        char buf[32];
+        const double r = p.delta[num] / p.delta[den];
+        if (percent) {
+            std::snprintf(buf, sizeof(buf), "%.2f%%", 100.0 * r);
+        } else {
+            std::snprintf(buf, sizeof(buf), "%.2f", r);
+        }
+        return buf;
+    }
+
+    bool enabled_;
+    std::array<int, kCounters> fd_;
+    std::string unavailable_; // why cycles could not be counted
+    bool running_ = false;
+    std::string current_;
+    Sample start_;
+    std::vector<Phase> phases_;
+};
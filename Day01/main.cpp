@@ -2,8 +2,18 @@
 #include <iostream>
 #include <string>
 #include <cctype>
+#include <cstring>
+
+#include "profile.h"
+
+int main(int argc, char* argv[]) {
+    // --profile: per-phase hardware counters on stderr
+    bool profile = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0) profile = true;
+    }
+    PhaseProfiler profiler(profile);
 
-int main() {
     std::ifstream in("input.txt");
     if (!in) {
         std::cerr << "Error: could not open input.txt\n";
@@ -19,6 +29,7 @@ int main() {
     // Part 2: number of times any click (during or at the end of a rotation) lands on 0
     long long zero_click_count = 0;
 
+    profiler.phase("solve");
     std::string line;
     while (std::getline(in, line)) {
         if (line.empty()) {
@@ -109,6 +120,7 @@ int main() {
 
     std::cout << "Part 1 (end-of-rotation zeros): " << zero_end_count << '\n';
     std::cout << "Part 2 (all clicks hitting 0):  " << zero_click_count << '\n';
+    profiler.report();
 
     return 0;
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <cstring>
+
+#include "profile.h"
 
 // Part 1: invalid if decimal representation is repeated exactly twice
 bool is_invalid_part1(long long n) {
@@ -52,19 +55,28 @@ bool is_invalid_part2(long long n) {
     return false;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // --profile: per-phase hardware counters on stderr
+    bool profile = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0) profile = true;
+    }
+    PhaseProfiler profiler(profile);
+
     std::ifstream in("input.txt");
     if (!in) {
         std::cerr << "Error: could not open input.txt\n";
         return 1;
     }
 
+    profiler.phase("read");
     std::string line;
     if (!std::getline(in, line)) {
         std::cerr << "Error: input.txt is empty or unreadable\n";
         return 1;
     }
 
+    profiler.phase("scan ranges");
     long long part1_sum = 0;
     long long part2_sum = 0;
 
@@ -114,5 +126,6 @@ int main() {
 
     std::cout << "Part 1 sum: " << part1_sum << '\n';
     std::cout << "Part 2 sum: " << part2_sum << '\n';
+    profiler.report();
     return 0;
 }
\ No newline at end of file
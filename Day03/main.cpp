@@ -3,8 +3,18 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+
+#include "profile.h"
+
+int main(int argc, char* argv[]) {
+    // --profile: per-phase hardware counters on stderr
+    bool profile = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0) profile = true;
+    }
+    PhaseProfiler profiler(profile);
 
-int main() {
     std::ifstream in("input.txt");
     if (!in) {
         std::cerr << "Error: could not open input.txt\n";
@@ -14,6 +24,7 @@ int main() {
     unsigned long long part1_total = 0; // sum of best 2-digit joltage per line
     unsigned long long part2_total = 0; // sum of best 12-digit joltage per line
 
+    profiler.phase("solve");
     std::string line;
     while (std::getline(in, line)) {
         if (line.empty()) {
@@ -86,6 +97,7 @@ int main() {
 
     std::cout << "Part 1 total joltage: " << part1_total << '\n';
     std::cout << "Part 2 total joltage: " << part2_total << '\n';
+    profiler.report();
 
     return 0;
 }
\ No newline at end of file
@@ -2,14 +2,25 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <cstring>
+
+#include "profile.h"
+
+int main(int argc, char* argv[]) {
+    // --profile: per-phase hardware counters on stderr
+    bool profile = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0) profile = true;
+    }
+    PhaseProfiler profiler(profile);
 
-int main() {
     std::ifstream in("input.txt");
     if (!in) {
         std::cerr << "Error: could not open input.txt\n";
         return 1;
     }
 
+    profiler.phase("parse");
     std::vector<std::string> grid;
     std::string line;
     while (std::getline(in, line)) {
@@ -35,6 +46,7 @@ int main() {
     // For each roll '@', count how many adjacent cells (8 directions)
     // also contain '@'. If that count is < 4, the roll is accessible
     // by a forklift.
+    profiler.phase("part 1");
     int accessible_initial = 0;
 
     for (int r = 0; r < rows; ++r) {
@@ -68,6 +80,7 @@ int main() {
     //  - Remove all of them at once (set to '.').
     //  - Keep a running total of how many rolls have been removed.
     // Stop when a step removes nothing more.
+    profiler.phase("part 2");
     std::vector<std::string> work = grid; // copy to modify
     long long total_removed = 0;
 
@@ -113,6 +126,7 @@ int main() {
 
     std::cout << "Part 1 (initial accessible rolls): " << accessible_initial << '\n';
     std::cout << "Part 2 (total removable rolls):   " << total_removed << '\n';
+    profiler.report();
 
     return 0;
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+
+#include "profile.h"
 
 using ll = long long;
 
@@ -43,13 +46,21 @@ std::vector<std::pair<ll, ll>> merge_ranges(std::vector<std::pair<ll, ll>> range
     return merged;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // --profile: per-phase hardware counters on stderr
+    bool profile = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0) profile = true;
+    }
+    PhaseProfiler profiler(profile);
+
     std::ifstream in("input.txt");
     if (!in) {
         std::cerr << "Error: could not open input.txt\n";
         return 1;
     }
 
+    profiler.phase("parse");
     std::vector<std::pair<ll, ll>> ranges;
     std::vector<ll> ids;
 
@@ -94,9 +105,11 @@ int main() {
     }
 
     // Merge ranges once, use for both parts
+    profiler.phase("merge");
     auto merged = merge_ranges(ranges);
 
     // Part 1: how many available IDs are fresh
+    profiler.phase("part 1");
     ll part1_fresh = 0;
     for (ll id : ids) {
         auto it = std::upper_bound(
@@ -120,6 +133,7 @@ int main() {
     }
 
     // Part 2: how many distinct IDs are covered by the ranges
+    profiler.phase("part 2");
     ll part2_total_ids = 0;
     for (const auto& [start, end] : merged) {
         part2_total_ids += (end - start + 1);
@@ -127,6 +141,7 @@ int main() {
 
     std::cout << "Part 1 (fresh available IDs): " << part1_fresh << '\n';
     std::cout << "Part 2 (total fresh IDs in ranges): " << part2_total_ids << '\n';
+    profiler.report();
 
     return 0;
 }
\ No newline at end of file
@@ -1,9 +1,336 @@
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
-int main() {
+#include "profile.h"
+
+using u64 = unsigned long long;
+using u128 = unsigned __int128;
+
+// Wide unsigned integer (little-endian 64-bit limbs) capped at kMaxLimbs
+// limbs. Only used once a value no longer fits in 128 bits, so the limbs live
+// on the heap and an unused WideUInt costs nothing to copy. Values that would
+// need more than kMaxLimbs limbs set `overflow` instead of wrapping.
+struct WideUInt {
+    static constexpr std::size_t kMaxLimbs = 64; // 4096 bits
+
+    std::vector<u64> limb;
+    bool overflow = false;
+
+    static WideUInt from(u128 v) {
+        WideUInt w;
+        while (v != 0) {
+            w.limb.push_back(static_cast<u64>(v));
+            v >>= 64;
+        }
+        return w;
+    }
+
+    void add(const WideUInt& o) {
+        overflow = overflow || o.overflow;
+        if (limb.size() < o.limb.size()) {
+            limb.resize(o.limb.size(), 0);
+        }
+        u64 carry = 0;
+        for (std::size_t i = 0; i < limb.size(); ++i) {
+            u128 s = static_cast<u128>(limb[i]) + (i < o.limb.size() ? o.limb[i] : 0) + carry;
+            limb[i] = static_cast<u64>(s);
+            carry = static_cast<u64>(s >> 64);
+        }
+        if (carry != 0) {
+            push_limb(carry);
+        }
+    }
+
+    void mul(const WideUInt& o) {
+        WideUInt r;
+        r.overflow = overflow || o.overflow;
+        r.limb.assign(limb.size() + o.limb.size(), 0);
+        for (std::size_t i = 0; i < limb.size(); ++i) {
+            u64 carry = 0;
+            for (std::size_t j = 0; j < o.limb.size(); ++j) {
+                u128 p = static_cast<u128>(limb[i]) * o.limb[j] + r.limb[i + j] + carry;
+                r.limb[i + j] = static_cast<u64>(p);
+                carry = static_cast<u64>(p >> 64);
+            }
+            r.limb[i + o.limb.size()] = carry;
+        }
+        r.trim();
+        if (r.limb.size() > kMaxLimbs) {
+            r.limb.resize(kMaxLimbs);
+            r.overflow = true;
+        }
+        *this = std::move(r);
+    }
+
+    std::string to_string() const {
+        if (overflow) {
+            return "overflow (more than " + std::to_string(kMaxLimbs * 64) + " bits)";
+        }
+        // Repeatedly divide by 10^19 and emit the remainders as 19-digit chunks.
+        const u64 chunk = 10000000000000000000ULL;
+        WideUInt q = *this;
+        std::vector<u64> parts;
+        while (!q.limb.empty()) {
+            u128 rem = 0;
+            for (std::size_t i = q.limb.size(); i-- > 0;) {
+                u128 cur = (rem << 64) | q.limb[i];
+                q.limb[i] = static_cast<u64>(cur / chunk);
+                rem = cur % chunk;
+            }
+            q.trim();
+            parts.push_back(static_cast<u64>(rem));
+        }
+        if (parts.empty()) {
+            return "0";
+        }
+        std::string s = std::to_string(parts.back());
+        for (std::size_t i = parts.size() - 1; i-- > 0;) {
+            std::string digits = std::to_string(parts[i]);
+            s.append(19 - digits.size(), '0');
+            s += digits;
+        }
+        return s;
+    }
+
+private:
+    void push_limb(u64 v) {
+        if (limb.size() == kMaxLimbs) {
+            overflow = true;
+        } else {
+            limb.push_back(v);
+        }
+    }
+
+    void trim() {
+        while (!limb.empty() && limb.back() == 0) {
+            limb.pop_back();
+        }
+    }
+};
+
+// Exact non-negative value with three representations. Arithmetic stays on
+// plain 64-bit integers guarded by __builtin_*_overflow, is promoted to
+// unsigned __int128 when that overflows, and only falls back to WideUInt when
+// 128 bits are not enough either.
+class CheckedValue {
+public:
+    CheckedValue(u64 v = 0) : small_(v) {}
+
+    void add(const CheckedValue& o) {
+        if (tier_ == 0 && o.tier_ == 0) {
+            u64 r;
+            if (!__builtin_add_overflow(small_, o.small_, &r)) {
+                small_ = r;
+                return;
+            }
+        }
+        add_slow(o);
+    }
+
+    void mul(const CheckedValue& o) {
+        if (tier_ == 0 && o.tier_ == 0) {
+            u64 r;
+            if (!__builtin_mul_overflow(small_, o.small_, &r)) {
+                small_ = r;
+                return;
+            }
+        }
+        mul_slow(o);
+    }
+
+    // Append one decimal digit: value = value * 10 + digit.
+    void push_digit(int digit) {
+        if (tier_ == 0) {
+            u64 r;
+            if (!__builtin_mul_overflow(small_, 10ULL, &r) &&
+                !__builtin_add_overflow(r, static_cast<u64>(digit), &r)) {
+                small_ = r;
+                return;
+            }
+        }
+        mul_slow(CheckedValue(10));
+        add_slow(CheckedValue(static_cast<u64>(digit)));
+    }
+
+    std::string to_string() const {
+        return tier_ == 0 ? std::to_string(small_) : as_wide().to_string();
+    }
+
+private:
+    u128 as_u128() const { return tier_ == 0 ? small_ : mid_; }
+    WideUInt as_wide() const { return tier_ == 2 ? wide_ : WideUInt::from(as_u128()); }
+
+    void set_u128(u128 v) {
+        tier_ = 1;
+        mid_ = v;
+    }
+
+    void set_wide(WideUInt w) {
+        tier_ = 2;
+        wide_ = std::move(w);
+    }
+
+    void add_slow(const CheckedValue& o) {
+        if (tier_ < 2 && o.tier_ < 2) {
+            u128 r;
+            if (!__builtin_add_overflow(as_u128(), o.as_u128(), &r)) {
+                set_u128(r);
+                return;
+            }
+        }
+        WideUInt w = as_wide();
+        w.add(o.as_wide());
+        set_wide(std::move(w));
+    }
+
+    void mul_slow(const CheckedValue& o) {
+        if (tier_ < 2 && o.tier_ < 2) {
+            u128 r;
+            if (!__builtin_mul_overflow(as_u128(), o.as_u128(), &r)) {
+                set_u128(r);
+                return;
+            }
+        }
+        WideUInt w = as_wide();
+        w.mul(o.as_wide());
+        set_wide(std::move(w));
+    }
+
+    int tier_ = 0; // 0: small_, 1: mid_, 2: wide_
+    u64 small_ = 0;
+    u128 mid_ = 0;
+    WideUInt wide_;
+};
+
+// Plain 64-bit value for the common case. Overflow is recorded in a sticky
+// flag instead of being handled inline, so the hot loops stay branch-light;
+// a block that overflows is evaluated again with CheckedValue.
+struct FastValue {
+    u64 v = 0;
+    bool overflow = false;
+
+    FastValue(u64 x = 0) : v(x) {}
+
+    void add(const FastValue& o) {
+        overflow |= __builtin_add_overflow(v, o.v, &v) | o.overflow;
+    }
+
+    void mul(const FastValue& o) {
+        overflow |= __builtin_mul_overflow(v, o.v, &v) | o.overflow;
+    }
+
+    void push_digit(int digit) {
+        overflow |= __builtin_mul_overflow(v, 10ULL, &v);
+        overflow |= __builtin_add_overflow(v, static_cast<u64>(digit), &v);
+    }
+};
+
+// One problem block: the inclusive column range [start_col, end_col]
+// between two all-space separator columns.
+struct Block {
+    int start_col;
+    int end_col;
+};
+
+// Results of one block (or a run of blocks) for both interpretations.
+struct Totals {
+    CheckedValue part1;
+    CheckedValue part2;
+};
+
+// Evaluate a single problem block into part1/part2. Numbers are assembled
+// digit by digit straight into Value, so no temporary strings or vectors are
+// needed. Returns false if the block has no operator.
+template <class Value>
+bool evaluate_block(const std::vector<std::string>& grid, int op_row, const Block& block,
+                    Value& part1, Value& part2) {
+    // 1) Find the operator in the last row (same for both parts).
+    char op = 0;
+    for (int cc = block.start_col; cc <= block.end_col; ++cc) {
+        char ch = grid[op_row][cc];
+        if (ch == '+' || ch == '*') {
+            op = ch;
+            break;
+        }
+    }
+    if (op == 0) {
+        // No operator found; skip this block
+        return false;
+    }
+
+    auto combine = [op](Value& acc, const Value& x) {
+        if (op == '+') {
+            acc.add(x);
+        } else {
+            acc.mul(x);
+        }
+    };
+    const u64 identity = (op == '+') ? 0 : 1;
+
+    // Part 1: row-wise numbers
+    // For each row above operator row, collect all digits in [start_col, end_col]
+    {
+        Value value(identity);
+        bool any_number = false;
+        for (int r = 0; r < op_row; ++r) {
+            const std::string& row = grid[r];
+            Value num;
+            bool has_digit = false;
+            for (int cc = block.start_col; cc <= block.end_col; ++cc) {
+                char ch = row[cc];
+                if (ch >= '0' && ch <= '9') {
+                    num.push_digit(ch - '0');
+                    has_digit = true;
+                }
+            }
+            if (has_digit) {
+                combine(value, num);
+                any_number = true;
+            }
+        }
+        part1 = any_number ? std::move(value) : Value();
+    }
+
+    // Part 2: column-wise numbers
+    // Cephalopod math: each column in the block is one number.
+    // We read columns from right to left, digits from top to just above operator row.
+    {
+        Value value2(identity);
+        bool any_number = false;
+        for (int cc = block.end_col; cc >= block.start_col; --cc) {
+            Value num;
+            bool has_digit = false;
+            for (int r = 0; r < op_row; ++r) {
+                char ch = grid[r][cc];
+                if (ch >= '0' && ch <= '9') {
+                    num.push_digit(ch - '0');
+                    has_digit = true;
+                }
+            }
+            if (has_digit) {
+                combine(value2, num);
+                any_number = true;
+            }
+        }
+        part2 = any_number ? std::move(value2) : Value();
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    // --profile: per-phase hardware counters on stderr
+    bool profile = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0) profile = true;
+    }
+    PhaseProfiler profiler(profile);
+
     std::ifstream in("input.txt");
     if (!in) {
         std::cerr << "Error: could not open input.txt\n";
@@ -11,6 +338,7 @@ int main() {
     }
 
     // Read all lines into a grid
+    profiler.phase("parse");
     std::vector<std::string> grid;
     std::string line;
     std::size_t max_width = 0;
@@ -38,24 +366,26 @@ int main() {
 
     int rows = static_cast<int>(grid.size());
     int cols = static_cast<int>(max_width);
+    int op_row = rows - 1;
 
-    // Helper: is column c completely empty (all spaces)?
-    auto is_empty_column = [&](int c) {
-        for (int r = 0; r < rows; ++r) {
-            if (grid[r][c] != ' ') {
-                return false;
+    profiler.phase("find blocks");
+    // Mark the separator columns (all spaces) in a single row-major pass
+    // instead of rescanning every column top to bottom.
+    std::vector<char> empty_column(cols, 1);
+    for (const auto& row : grid) {
+        for (int c = 0; c < cols; ++c) {
+            if (row[c] != ' ') {
+                empty_column[c] = 0;
             }
         }
-        return true;
-    };
-
-    long long grand_total_part1 = 0; // original interpretation (row-wise numbers)
-    long long grand_total_part2 = 0; // cephalopod interpretation (column-wise numbers)
+    }
 
+    // Find all block boundaries first; the blocks are independent afterwards.
+    std::vector<Block> blocks;
     int c = 0;
     while (c < cols) {
         // Skip separator columns (all empty spaces)
-        while (c < cols && is_empty_column(c)) {
+        while (c < cols && empty_column[c]) {
             ++c;
         }
         if (c >= cols) {
@@ -64,103 +394,76 @@ int main() {
 
         int start_col = c;
         // Advance until we hit an empty column or end -> defines one problem block [start_col, end_col]
-        while (c < cols && !is_empty_column(c)) {
+        while (c < cols && !empty_column[c]) {
             ++c;
         }
-        int end_col = c - 1;
-
-        // We now have one problem block in columns [start_col, end_col].
+        blocks.push_back({start_col, c - 1});
+    }
 
-        // 1) Find the operator in the last row (same for both parts).
-        int op_row = rows - 1;
-        char op = 0;
-        for (int cc = start_col; cc <= end_col; ++cc) {
-            char ch = grid[op_row][cc];
-            if (ch == '+' || ch == '*') {
-                op = ch;
-                break;
-            }
-        }
-        if (op == 0) {
-            // No operator found; skip this block
-            continue;
-        }
+    // Evaluate the blocks in parallel: each worker sums a contiguous run of
+    // blocks into its own Totals, which are reduced at the end.
+    profiler.phase("evaluate");
+    const std::size_t min_blocks_per_worker = 1024;
+    std::size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, (blocks.size() + min_blocks_per_worker - 1) / min_blocks_per_worker);
+    workers = std::max<std::size_t>(workers, 1);
 
-        // Part 1: row-wise numbers
-        // For each row above operator row, collect all digits in [start_col, end_col]
-        {
-            std::vector<long long> nums;
-            for (int r = 0; r < op_row; ++r) {
-                std::string num_str;
-                for (int cc = start_col; cc <= end_col; ++cc) {
-                    char ch = grid[r][cc];
-                    if (std::isdigit(static_cast<unsigned char>(ch))) {
-                        num_str.push_back(ch);
-                    }
-                }
-                if (!num_str.empty()) {
-                    long long val = std::stoll(num_str);
-                    nums.push_back(val);
-                }
+    std::vector<Totals> partial(workers);
+    auto run_worker = [&](std::size_t w) {
+        std::size_t begin = blocks.size() * w / workers;
+        std::size_t end = blocks.size() * (w + 1) / workers;
+        Totals local;
+        FastValue sum1, sum2;
+        for (std::size_t i = begin; i < end; ++i) {
+            FastValue v1, v2;
+            if (!evaluate_block(grid, op_row, blocks[i], v1, v2)) {
+                continue;
             }
-
-            if (!nums.empty()) {
-                long long value;
-                if (op == '+') {
-                    value = 0;
-                    for (long long x : nums) {
-                        value += x;
-                    }
-                } else { // op == '*'
-                    value = 1;
-                    for (long long x : nums) {
-                        value *= x;
-                    }
+            if (!v1.overflow && !v2.overflow) {
+                sum1.add(v1);
+                sum2.add(v2);
+                if (sum1.overflow || sum2.overflow) {
+                    // Running 64-bit sums are full: flush them into the exact totals.
+                    sum1.v -= v1.v;
+                    sum2.v -= v2.v;
+                    local.part1.add(sum1.v);
+                    local.part2.add(sum2.v);
+                    sum1 = v1;
+                    sum2 = v2;
                 }
-                grand_total_part1 += value;
+                continue;
             }
+            // Rare slow path: this block needs more than 64 bits.
+            CheckedValue c1, c2;
+            evaluate_block(grid, op_row, blocks[i], c1, c2);
+            local.part1.add(c1);
+            local.part2.add(c2);
         }
+        local.part1.add(sum1.v);
+        local.part2.add(sum2.v);
+        partial[w] = std::move(local);
+    };
 
-        // Part 2: column-wise numbers
-        // Cephalopod math: each column in the block is one number.
-        // We read columns from right to left, digits from top to just above operator row.
-        {
-            std::vector<long long> nums2;
-
-            for (int cc = end_col; cc >= start_col; --cc) {
-                std::string num_str;
-                for (int r = 0; r < op_row; ++r) {
-                    char ch = grid[r][cc];
-                    if (std::isdigit(static_cast<unsigned char>(ch))) {
-                        num_str.push_back(ch);
-                    }
-                }
-                if (!num_str.empty()) {
-                    long long val = std::stoll(num_str);
-                    nums2.push_back(val);
-                }
-            }
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (std::size_t w = 1; w < workers; ++w) {
+        threads.emplace_back(run_worker, w);
+    }
+    run_worker(0);
+    for (auto& t : threads) {
+        t.join();
+    }
 
-            if (!nums2.empty()) {
-                long long value2;
-                if (op == '+') {
-                    value2 = 0;
-                    for (long long x : nums2) {
-                        value2 += x;
-                    }
-                } else { // op == '*'
-                    value2 = 1;
-                    for (long long x : nums2) {
-                        value2 *= x;
-                    }
-                }
-                grand_total_part2 += value2;
-            }
-        }
+    CheckedValue grand_total_part1; // original interpretation (row-wise numbers)
+    CheckedValue grand_total_part2; // cephalopod interpretation (column-wise numbers)
+    for (const auto& t : partial) {
+        grand_total_part1.add(t.part1);
+        grand_total_part2.add(t.part2);
     }
 
-    std::cout << "Part 1 grand total: " << grand_total_part1 << '\n';
-    std::cout << "Part 2 grand total: " << grand_total_part2 << '\n';
+    std::cout << "Part 1 grand total: " << grand_total_part1.to_string() << '\n';
+    std::cout << "Part 2 grand total: " << grand_total_part2.to_string() << '\n';
+    profiler.report();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,178 +1,486 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <utility>
 #include <vector>
 
-int main() {
-    std::ifstream in("input.txt");
-    if (!in) {
-        std::cerr << "Error: could not open input.txt\n";
-        return 1;
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "profile.h"
+
+using u64 = std::uint64_t;
+
+// Packs up to 64 columns of a row into a word: bit c is set iff row[c] == '^'.
+// Uses 16-byte SSE2 compares where available.
+inline u64 splitter_bits(const char* row, int len) {
+    u64 bits = 0;
+    int c = 0;
+#if defined(__SSE2__)
+    const __m128i caret = _mm_set1_epi8('^');
+    for (; c + 16 <= len; c += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + c));
+        u64 m = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, caret)));
+        bits |= m << c;
     }
+#endif
+    for (; c < len; ++c) {
+        bits |= static_cast<u64>(row[c] == '^') << c;
+    }
+    return bits;
+}
 
-    // Read the grid
-    std::vector<std::string> grid;
-    std::string line;
-    while (std::getline(in, line)) {
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back(); // handle CRLF if needed
+// Timeline counters. The number of timelines doubles at every splitter, so
+// the engine is a template over the counter type and one of these is picked
+// at compile time with -DDAY07_COUNTER=<n> (see main). Each counter needs a
+// zero default, construction from 1, operator+= and count_to_string().
+
+using u128 = unsigned __int128;
+
+// 0 and 1: 64-bit and unsigned __int128 counters that record overflow
+// instead of wrapping silently.
+template <class U>
+struct CheckedCount {
+    U value = 0;
+    bool overflow = false;
+
+    CheckedCount(U v = 0) : value(v) {}
+
+    CheckedCount& operator+=(const CheckedCount& o) {
+        overflow |= __builtin_add_overflow(value, o.value, &value) | o.overflow;
+        return *this;
+    }
+};
+
+using Checked64 = CheckedCount<u64>;
+using Checked128 = CheckedCount<u128>;
+
+template <class U>
+std::string count_to_string(const CheckedCount<U>& c) {
+    if (c.overflow) {
+        return "overflow (rebuild with DAY07_COUNTER=2 for exact counts)";
+    }
+    std::string s;
+    U v = c.value;
+    do {
+        s.push_back(static_cast<char>('0' + static_cast<int>(v % 10)));
+        v /= 10;
+    } while (v != 0);
+    return std::string(s.rbegin(), s.rend());
+}
+
+// 2: exact multi-limb counter (little-endian 64-bit limbs).
+struct BigCount {
+    std::vector<u64> limb;
+
+    BigCount(u64 v = 0) {
+        if (v != 0) limb.push_back(v);
+    }
+
+    BigCount& operator+=(const BigCount& o) {
+        if (limb.size() < o.limb.size()) {
+            limb.resize(o.limb.size(), 0);
         }
-        if (!line.empty()) {
-            grid.push_back(line);
+        u64 carry = 0;
+        for (std::size_t i = 0; i < limb.size(); ++i) {
+            u128 sum = static_cast<u128>(limb[i]) + (i < o.limb.size() ? o.limb[i] : 0) + carry;
+            limb[i] = static_cast<u64>(sum);
+            carry = static_cast<u64>(sum >> 64);
         }
+        if (carry != 0) {
+            limb.push_back(carry);
+        }
+        return *this;
     }
+};
 
-    if (grid.empty()) {
-        std::cout << "Part 1: 0\n";
-        std::cout << "Part 2: 0\n";
-        return 0;
+std::string count_to_string(const BigCount& c) {
+    // Repeatedly divide by 10^19 and emit the remainders as 19-digit chunks.
+    const u64 chunk = 10000000000000000000ULL;
+    std::vector<u64> q = c.limb;
+    std::vector<u64> parts;
+    while (!q.empty()) {
+        u128 rem = 0;
+        for (std::size_t i = q.size(); i-- > 0;) {
+            u128 cur = (rem << 64) | q[i];
+            q[i] = static_cast<u64>(cur / chunk);
+            rem = cur % chunk;
+        }
+        while (!q.empty() && q.back() == 0) {
+            q.pop_back();
+        }
+        parts.push_back(static_cast<u64>(rem));
+    }
+    if (parts.empty()) {
+        return "0";
     }
+    std::string s = std::to_string(parts.back());
+    for (std::size_t i = parts.size() - 1; i-- > 0;) {
+        std::string digits = std::to_string(parts[i]);
+        s.append(19 - digits.size(), '0');
+        s += digits;
+    }
+    return s;
+}
 
-    int rows = static_cast<int>(grid.size());
-    int cols = static_cast<int>(grid[0].size());
+// 3: counts modulo a prime P.
+template <u64 P>
+struct ModCount {
+    static_assert(P > 1 && P < (u64{1} << 63), "modulus must fit in 63 bits");
 
-    // Find the starting point 'S'
-    int start_row = -1;
-    int start_col = -1;
-    for (int r = 0; r < rows; ++r) {
-        for (int c = 0; c < cols; ++c) {
-            if (grid[r][c] == 'S') {
-                start_row = r;
-                start_col = c;
-                break;
-            }
-        }
-        if (start_row != -1) break;
+    u64 value = 0;
+
+    ModCount(u64 v = 0) : value(v % P) {}
+
+    ModCount& operator+=(const ModCount& o) {
+        value += o.value;
+        if (value >= P) value -= P;
+        return *this;
     }
+};
 
-    if (start_row == -1) {
-        std::cerr << "Error: no 'S' found in grid\n";
-        return 1;
+template <u64 P>
+std::string count_to_string(const ModCount<P>& c) {
+    return std::to_string(c.value) + " (mod " + std::to_string(P) + ")";
+}
+
+template <class Count>
+struct Beam {
+    int col;
+    Count ways;
+};
+
+// Fused engine for both parts. The manifold is consumed one row at a time
+// and only two rolling rows of timeline counts are kept, so memory is
+// O(cols) regardless of how tall the input is.
+//
+// Part 1: classical beams, count splitter hits
+//  - Beams and splitters of a row are 64-bit word bitsets, so one row step
+//    is a handful of word operations per 64 columns:
+//      hit  = active & split      (popcount -> split counter)
+//      pass = active & ~split
+//      next = pass | (hit << 1) | (hit >> 1)
+//  - Beams only move downward.
+//  - On '.', beam continues straight.
+//  - On '^', beam stops and two new beams spawn left/right.
+//  - We count how many times any beam hits '^'.
+//
+// Part 2: quantum many-worlds timelines
+//  - Only one particle is sent in.
+//  - At each splitter '^', the timeline splits in two:
+//      left and right branches both exist.
+//  - We want to count how many distinct timelines exist
+//    after the particle has completed all possible journeys
+//    (i.e., after all branches exit the manifold).
+//
+//  ways[c] = number of distinct histories that place the particle in
+//            column c of the current row, moving downwards.
+//
+// Only columns set in the active bitset can hold a non-zero count, so the
+// Part 2 update walks the set bits instead of every column.
+//
+// On very wide, mostly empty manifolds even the word loop is wasted work, so
+// the engine also has a sparse mode: the frontier is a sorted vector of
+// (column, ways) beams, and each beam looks up its own cell of the row. A
+// row then costs time proportional to the active beams. The engine switches between the modes automatically based on
+// how many columns are active.
+//
+// Transitions:
+//   '.' : next[c] += ways[c]
+//   '^' : split into two:
+//         left  -> next[c-1]
+//         right -> next[c+1]
+//         if a branch leaves through the left/right side, that
+//         contributes directly to the final timeline count.
+// Whatever is still in `ways` after the last row exits through the bottom.
+template <class Count>
+class BeamEngine {
+public:
+    BeamEngine(int cols, int start_col)
+        : cols_(cols),
+          words_((cols + 63) / 64),
+          active_(words_, 0),
+          next_active_(words_, 0),
+          split_(words_, 0),
+          ways_(cols),
+          next_ways_(cols) {
+        // The particle first appears in the cell just below 'S'
+        frontier_.push_back({start_col, Count{1}});
     }
 
-    // Part 1: classical beams, count splitter hits
-    //  - We track which columns currently have a beam in this row.
-    //  - Beams only move downward.
-    //  - On '.', beam continues straight.
-    //  - On '^', beam stops and two new beams spawn left/right.
-    //  - We count how many times any beam hits '^'.
-    long long split_count = 0;
+    // Advance every beam through one manifold row.
+    void step(const std::string& row) {
+        stepped_ = true;
 
-    std::vector<bool> active(cols, false);
-    std::vector<bool> next_active(cols, false);
+        if (sparse_) {
+            step_sparse(row);
+            if (static_cast<long long>(frontier_.size()) * kDenseRatio > cols_) {
+                to_dense();
+            }
+        } else {
+            long long active = step_dense(row);
+            if (active * kSparseRatio < cols_) {
+                to_sparse();
+            }
+        }
+    }
 
-    // First beams start just below S, if that row exists.
-    if (start_row + 1 < rows) {
-        active[start_col] = true;
+    long long split_count() const { return split_count_; }
+
+    // Timelines that left the manifold, including those still falling out
+    // of the bottom after the last row.
+    Count timeline_count() const {
+        if (!stepped_) return Count{}; // 'S' was on the last row
+        Count total = timeline_count_;
+        if (sparse_) {
+            for (const Beam<Count>& b : frontier_) {
+                total += b.ways;
+            }
+        } else {
+            for (const Count& w : ways_) {
+                total += w;
+            }
+        }
+        return total;
     }
 
-    for (int r = start_row + 1; r < rows; ++r) {
-        std::fill(next_active.begin(), next_active.end(), false);
+private:
+    // Go sparse below cols / kSparseRatio active columns, back to dense above
+    // cols / kDenseRatio; the gap avoids flipping on every row.
+    static constexpr long long kSparseRatio = 256;
+    static constexpr long long kDenseRatio = 64;
 
-        for (int c = 0; c < cols; ++c) {
-            if (!active[c]) continue; // no beam in this column at this row
+    // Dense step over word bitsets; returns the number of active columns
+    // in the next row.
+    long long step_dense(const std::string& row) {
+        for (int i = 0; i < words_; ++i) {
+            int base = i * 64;
+            split_[i] = splitter_bits(row.data() + base, std::min(64, cols_ - base));
+        }
 
-            char cell = grid[r][c];
+        // Part 1: word-parallel beam propagation
+        u64 hit_prev = 0;
+        u64 hit_cur = active_[0] & split_[0];
+        for (int i = 0; i < words_; ++i) {
+            u64 hit_next = (i + 1 < words_) ? (active_[i + 1] & split_[i + 1]) : 0;
+            u64 pass = active_[i] & ~split_[i];
+            split_count_ += std::popcount(hit_cur);
+            next_active_[i] = pass
+                            | (hit_cur << 1) | (hit_prev >> 63)   // right branches
+                            | (hit_cur >> 1) | (hit_next << 63);  // left branches
+            hit_prev = hit_cur;
+            hit_cur = hit_next;
+        }
+        // Right branches of the last column leave the manifold
+        if (cols_ % 64 != 0) {
+            next_active_[words_ - 1] &= (u64{1} << (cols_ % 64)) - 1;
+        }
+        long long active = 0;
+        for (int i = 0; i < words_; ++i) {
+            active += std::popcount(next_active_[i]);
+        }
+
+        // Part 2: move the timeline counts of the active columns
+        for (int i = 0; i < words_; ++i) {
+            for (u64 bits = active_[i]; bits != 0; bits &= bits - 1) {
+                int c = i * 64 + std::countr_zero(bits);
+                Count w = std::move(ways_[c]);
+                ways_[c] = Count{};
 
-            if (cell == '.') {
-                // Beam passes straight down
-                next_active[c] = true;
-            } else if (cell == '^') {
-                // Beam hits splitter: count split, spawn left/right beams
-                ++split_count;
+                if (!((split_[i] >> (c & 63)) & 1)) {
+                    // Behaves like empty space: particle goes straight down
+                    // (S shouldn't appear below start anyway)
+                    next_ways_[c] += w;
+                    continue;
+                }
 
+                // Splitter: timeline splits into left and right branches
                 if (c - 1 >= 0) {
-                    next_active[c - 1] = true;
+                    next_ways_[c - 1] += w;
+                } else {
+                    timeline_count_ += w; // leaves through the left side
                 }
-                if (c + 1 < cols) {
-                    next_active[c + 1] = true;
+                if (c + 1 < cols_) {
+                    next_ways_[c + 1] += w;
+                } else {
+                    timeline_count_ += w; // leaves through the right side
                 }
-                // Beam in this column stops here
-            } else {
-                // Treat any other char as empty (S shouldn't appear below start anyway)
-                next_active[c] = true;
             }
         }
 
-        active.swap(next_active);
-    }
-
-    // Part 2: quantum many-worlds timelines
-    //  - Only one particle is sent in.
-    //  - At each splitter '^', the timeline splits in two:
-    //      left and right branches both exist.
-    //  - We want to count how many distinct timelines exist
-    //    after the particle has completed all possible journeys
-    //    (i.e., after all branches exit the manifold).
-    //
-    // We do DP over the grid:
-    //  ways[r][c] = number of distinct histories that place
-    //               the particle at cell (r, c) moving downwards.
-    //
-    // Transitions:
-    //   '.' : ways[r+1][c] += ways[r][c]  (or exits at bottom)
-    //   '^' : split into two:
-    //         left  -> (r+1, c-1)
-    //         right -> (r+1, c+1)
-    //         if a branch goes out-of-bounds (left/right or bottom),
-    //         that contributes directly to final timeline count.
-    long long timeline_count = 0;
-    std::vector<std::vector<long long>> ways(rows, std::vector<long long>(cols, 0));
-
-    // The particle first appears in the cell just below 'S'
-    if (start_row + 1 < rows) {
-        ways[start_row + 1][start_col] = 1;
-    }
-
-    for (int r = start_row + 1; r < rows; ++r) {
-        for (int c = 0; c < cols; ++c) {
-            long long w = ways[r][c];
-            if (w == 0) continue;
-
-            char cell = grid[r][c];
-            bool is_splitter = (cell == '^');
-
-            if (!is_splitter) {
+        active_.swap(next_active_);
+        ways_.swap(next_ways_);
+        return active;
+    }
+
+    // Sparse step: look up the row's cell under each frontier beam, so the
+    // rest of the row is never read.
+    void step_sparse(const std::string& row) {
+        next_frontier_.clear();
+        for (const Beam<Count>& b : frontier_) {
+            if (row[b.col] != '^') {
                 // Behaves like empty space: particle goes straight down
-                int nr = r + 1;
-                int nc = c;
-                if (nr >= rows) {
-                    // Exits the bottom of the manifold
-                    timeline_count += w;
-                } else {
-                    ways[nr][nc] += w;
-                }
+                add_to_next(b.col, b.ways);
+                continue;
+            }
+
+            // Splitter: count the hit, timeline splits into left and right branches
+            ++split_count_;
+            if (b.col - 1 >= 0) {
+                add_to_next(b.col - 1, b.ways);
             } else {
-                // Splitter: timeline splits into left and right branches
-                int nr = r + 1;
+                timeline_count_ += b.ways; // leaves through the left side
+            }
+            if (b.col + 1 < cols_) {
+                add_to_next(b.col + 1, b.ways);
+            } else {
+                timeline_count_ += b.ways; // leaves through the right side
+            }
+        }
 
-                // Left branch
-                int lc = c - 1;
-                if (lc < 0 || nr >= rows) {
-                    // Goes out of bounds (left or bottom) -> contributes a timeline
-                    timeline_count += w;
-                } else {
-                    ways[nr][lc] += w;
-                }
+        frontier_.swap(next_frontier_);
+    }
 
-                // Right branch
-                int rc = c + 1;
-                if (rc >= cols || nr >= rows) {
-                    // Goes out of bounds (right or bottom) -> contributes a timeline
-                    timeline_count += w;
-                } else {
-                    ways[nr][rc] += w;
-                }
+    // Adds a contribution to the next frontier, keeping it sorted and merged.
+    // Beams are visited in column order, so a new column is at most a couple
+    // of entries behind the end.
+    void add_to_next(int col, const Count& w) {
+        std::size_t k = next_frontier_.size();
+        while (k > 0 && next_frontier_[k - 1].col > col) {
+            --k;
+        }
+        if (k > 0 && next_frontier_[k - 1].col == col) {
+            next_frontier_[k - 1].ways += w;
+        } else {
+            next_frontier_.insert(next_frontier_.begin() + k, Beam<Count>{col, w});
+        }
+    }
+
+    void to_sparse() {
+        frontier_.clear();
+        for (int i = 0; i < words_; ++i) {
+            for (u64 bits = active_[i]; bits != 0; bits &= bits - 1) {
+                int c = i * 64 + std::countr_zero(bits);
+                frontier_.push_back({c, std::move(ways_[c])});
+                ways_[c] = Count{};
             }
+            active_[i] = 0;
         }
+        sparse_ = true;
     }
 
-    // It's possible that the last row contains particles that haven't "stepped"
-    // out yet only if we didn't treat their move; but in this formulation,
-    // every move either goes to row+1 or exits, so all exits are already counted.
+    void to_dense() {
+        for (Beam<Count>& b : frontier_) {
+            active_[b.col >> 6] |= u64{1} << (b.col & 63);
+            ways_[b.col] = std::move(b.ways);
+        }
+        frontier_.clear();
+        sparse_ = false;
+    }
+
+    int cols_;
+    int words_;
+    std::vector<u64> active_;
+    std::vector<u64> next_active_;
+    std::vector<u64> split_;
+    std::vector<Count> ways_;
+    std::vector<Count> next_ways_;
+    std::vector<Beam<Count>> frontier_;
+    std::vector<Beam<Count>> next_frontier_;
+    bool sparse_ = true;
+    long long split_count_ = 0;
+    Count timeline_count_{};
+    bool stepped_ = false;
+};
+
+#ifndef DAY07_COUNTER
+#define DAY07_COUNTER 0
+#endif
+#ifndef DAY07_MODULUS
+#define DAY07_MODULUS 1000000007
+#endif
+
+#if DAY07_COUNTER == 0
+using TimelineCount = Checked64;
+#elif DAY07_COUNTER == 1
+using TimelineCount = Checked128;
+#elif DAY07_COUNTER == 2
+using TimelineCount = BigCount;
+#elif DAY07_COUNTER == 3
+using TimelineCount = ModCount<DAY07_MODULUS>;
+#else
+#error "DAY07_COUNTER must be 0 (checked 64-bit), 1 (checked __int128), 2 (exact) or 3 (modular)"
+#endif
+
+int main(int argc, char* argv[]) {
+    // --profile: per-phase hardware counters on stderr
+    bool profile = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0) profile = true;
+    }
+    PhaseProfiler profiler(profile);
+
+    std::ifstream in("input.txt");
+    if (!in) {
+        std::cerr << "Error: could not open input.txt\n";
+        return 1;
+    }
+
+    // Reads the next non-empty row, padded to the manifold width.
+    int cols = -1;
+    std::string line;
+    auto next_row = [&]() -> bool {
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back(); // handle CRLF if needed
+            }
+            if (line.empty()) continue;
+            if (cols == -1) {
+                cols = static_cast<int>(line.size());
+            }
+            if (static_cast<int>(line.size()) < cols) {
+                line.resize(cols, '.');
+            }
+            return true;
+        }
+        return false;
+    };
+
+    // Find the starting point 'S'; rows above it never carry a beam.
+    profiler.phase("find start");
+    int start_col = -1;
+    while (start_col == -1 && next_row()) {
+        std::size_t pos = line.find('S');
+        if (pos != std::string::npos && static_cast<int>(pos) < cols) {
+            start_col = static_cast<int>(pos);
+        }
+    }
+
+    if (cols == -1) {
+        std::cout << "Part 1: 0\n";
+        std::cout << "Part 2: 0\n";
+        return 0;
+    }
+
+    if (start_col == -1) {
+        std::cerr << "Error: no 'S' found in grid\n";
+        return 1;
+    }
+
+    profiler.phase("sweep");
+    BeamEngine<TimelineCount> engine(cols, start_col);
+    while (next_row()) {
+        engine.step(line);
+    }
 
-    std::cout << "Part 1 (total splits):    " << split_count << '\n';
-    std::cout << "Part 2 (total timelines): " << timeline_count << '\n';
+    std::cout << "Part 1 (total splits):    " << engine.split_count() << '\n';
+    std::cout << "Part 2 (total timelines): " << count_to_string(engine.timeline_count()) << '\n';
+    profiler.report();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -4,8 +4,23 @@
 #include <vector>
 #include <algorithm>
 #include <sstream>
+#include <queue>
+#include <thread>
+#include <tuple>
+#include <cstdint>
+#include <cctype>
+#include <cmath>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <limits>
+#include <atomic>
+
+#include "profile.h"
 
 using ll = long long;
+using u64 = std::uint64_t;
+using i128 = __int128;
 
 struct Point {
     ll x, y, z;
@@ -14,6 +29,10 @@ struct Point {
 struct Edge {
     ll dist2;
     int a, b;
+
+    bool operator<(const Edge& o) const {
+        return std::tie(dist2, a, b) < std::tie(o.dist2, o.a, o.b);
+    }
 };
 
 // Disjoint Set Union/Union-Find
@@ -55,119 +74,1262 @@ struct DSU {
     }
 };
 
-int main() {
-    std::ifstream in("input.txt");
-    if (!in) {
-        std::cerr << "Error: could not open input.txt\n";
-        return 1;
+// Neighbour of a query point, ordered by (dist2, index).
+struct Neighbor {
+    ll dist2;
+    int idx;
+
+    bool operator<(const Neighbor& o) const {
+        return std::tie(dist2, idx) < std::tie(o.dist2, o.idx);
     }
+};
 
-    std::vector<Point> points;
-    std::string line;
+ll distance2(const Point& p, const Point& q) {
+    ll dx = p.x - q.x;
+    ll dy = p.y - q.y;
+    ll dz = p.z - q.z;
+    return dx * dx + dy * dy + dz * dz;
+}
 
-    // Parse lines of form "x,y,z"
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
+// Static k-d tree stored implicitly in an index array: the node for a range
+// [lo, hi) is its middle element, split along the axis of largest spread.
+class KdTree {
+public:
+    explicit KdTree(const std::vector<Point>& points)
+        : points_(points), order_(points.size()), axis_(points.size(), 0),
+          box_lo_(points.size()), box_hi_(points.size()), node_label_(points.size()),
+          uniform_(points.size(), -1) {
+        for (std::size_t i = 0; i < order_.size(); ++i) {
+            order_[i] = static_cast<int>(i);
+        }
+        build(0, static_cast<int>(order_.size()));
+        sorted_.reserve(order_.size());
+        for (int id : order_) {
+            sorted_.push_back(points_[id]);
+        }
+    }
 
-        std::stringstream ss(line);
-        ll x, y, z;
-        char c1, c2;
-        if (!(ss >> x >> c1 >> y >> c2 >> z)) {
-            continue; // malformed line
+    // The k nearest neighbours of point `self` (excluding itself), sorted by
+    // (dist2, index). Returns fewer than k only when there are no more points.
+    void knn(int self, int k, std::vector<Neighbor>& out) const {
+        out.clear();
+        if (k <= 0) return;
+        std::priority_queue<Neighbor> heap; // max-heap of the best k so far
+        query(0, static_cast<int>(order_.size()), self, k, heap);
+        out.resize(heap.size());
+        for (std::size_t i = out.size(); i-- > 0;) {
+            out[i] = heap.top();
+            heap.pop();
         }
-        points.push_back({x, y, z});
     }
 
-    int n = static_cast<int>(points.size());
-    if (n == 0) {
-        std::cout << "Part 1: 0\n";
-        std::cout << "Part 2: 0\n";
-        return 0;
+    // Point indices in tree order; consecutive entries are spatially close.
+    const std::vector<int>& order() const { return order_; }
+
+    // Copies component labels (label[i] >= 0 for point i) into tree order and
+    // caches, per subtree, the label shared by all of its points, or -1.
+    void relabel(const std::vector<int>& label) {
+        for (std::size_t k = 0; k < order_.size(); ++k) {
+            node_label_[k] = label[order_[k]];
+        }
+        relabel(0, static_cast<int>(order_.size()));
     }
 
-    // Build all edges with squared Euclidean distance
-    std::vector<Edge> edges;
-    edges.reserve(static_cast<std::size_t>(n) * (n - 1) / 2);
+    // Lightest edge, in (dist2, a, b) order, from `self` to a point with a
+    // different label; `label` must be the one last passed to relabel().
+    // `best` is an upper bound on entry and is only
+    // replaced by lighter edges. Subtrees wholly inside the own component
+    // or farther than `best` are skipped.
+    void nearest_foreign(int self, const std::vector<int>& label, Edge& best) const {
+        foreign(0, static_cast<int>(order_.size()), self, points_[self], label[self], best);
+    }
 
-    for (int i = 0; i < n; ++i) {
-        for (int j = i + 1; j < n; ++j) {
-            ll dx = points[i].x - points[j].x;
-            ll dy = points[i].y - points[j].y;
-            ll dz = points[i].z - points[j].z;
-            ll d2 = dx * dx + dy * dy + dz * dz;
-            edges.push_back({d2, i, j});
+private:
+    static ll coord(const Point& p, int axis) {
+        return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+    }
+
+    void build(int lo, int hi) {
+        if (hi - lo <= 0) return;
+
+        // Split along the axis with the largest spread
+        ll min_c[3] = {points_[order_[lo]].x, points_[order_[lo]].y, points_[order_[lo]].z};
+        ll max_c[3] = {min_c[0], min_c[1], min_c[2]};
+        for (int i = lo + 1; i < hi; ++i) {
+            for (int a = 0; a < 3; ++a) {
+                ll v = coord(points_[order_[i]], a);
+                min_c[a] = std::min(min_c[a], v);
+                max_c[a] = std::max(max_c[a], v);
+            }
+        }
+        int mid = (lo + hi) / 2;
+        box_lo_[mid] = Point{min_c[0], min_c[1], min_c[2]};
+        box_hi_[mid] = Point{max_c[0], max_c[1], max_c[2]};
+        if (hi - lo == 1) return;
+
+        int axis = 0;
+        for (int a = 1; a < 3; ++a) {
+            if (max_c[a] - min_c[a] > max_c[axis] - min_c[axis]) axis = a;
         }
+
+        std::nth_element(order_.begin() + lo, order_.begin() + mid, order_.begin() + hi,
+                         [&](int a, int b) {
+                             return coord(points_[a], axis) < coord(points_[b], axis);
+                         });
+        axis_[mid] = axis;
+        build(lo, mid);
+        build(mid + 1, hi);
     }
 
-    // Sort edges by distance ascending (using squared distance)
-    std::sort(edges.begin(), edges.end(),
-              [](const Edge& e1, const Edge& e2) {
-                  return e1.dist2 < e2.dist2;
-              });
+    void query(int lo, int hi, int self, int k, std::priority_queue<Neighbor>& heap) const {
+        if (lo >= hi) return;
+        int mid = (lo + hi) / 2;
+        int id = order_[mid];
+        const Point& q = points_[self];
 
-    // Part 1: first 1000 connections
-    const int K = 1000;
-    std::size_t limit = std::min<std::size_t>(K, edges.size());
+        if (id != self) {
+            Neighbor cand{distance2(q, points_[id]), id};
+            if (static_cast<int>(heap.size()) < k) {
+                heap.push(cand);
+            } else if (cand < heap.top()) {
+                heap.pop();
+                heap.push(cand);
+            }
+        }
+        if (hi - lo == 1) return;
+
+        int axis = axis_[mid];
+        ll diff = coord(q, axis) - coord(points_[id], axis);
+        bool left_first = diff < 0;
+        query(left_first ? lo : mid + 1, left_first ? mid : hi, self, k, heap);
+        // Equal distances still matter for the (dist2, index) tie-break.
+        if (static_cast<int>(heap.size()) < k || diff * diff <= heap.top().dist2) {
+            query(left_first ? mid + 1 : lo, left_first ? hi : mid, self, k, heap);
+        }
+    }
 
-    DSU dsu1(n);
+    // Squared distance from q to the bounding box of the subtree at `node`.
+    ll box_distance2(const Point& q, int node) const {
+        ll d2 = 0;
+        for (int a = 0; a < 3; ++a) {
+            ll v = coord(q, a);
+            ll lo = coord(box_lo_[node], a);
+            ll hi = coord(box_hi_[node], a);
+            ll d = v < lo ? lo - v : (v > hi ? v - hi : 0);
+            d2 += d * d;
+        }
+        return d2;
+    }
 
-    for (std::size_t i = 0; i < limit; ++i) {
-        dsu1.unite(edges[i].a, edges[i].b);
-        // Even if already connected, we still "used" this pair;
-        // that's exactly how the puzzle describes it.
+    static constexpr int kEmpty = -2;
+
+    int relabel(int lo, int hi) {
+        if (lo >= hi) return kEmpty;
+        int mid = (lo + hi) / 2;
+        int left = relabel(lo, mid);
+        int right = relabel(mid + 1, hi);
+        int own = node_label_[mid];
+        bool same = (left == kEmpty || left == own) && (right == kEmpty || right == own);
+        uniform_[mid] = same ? own : -1;
+        return uniform_[mid];
+    }
+
+    void foreign(int lo, int hi, int self, const Point& q, int own, Edge& best) const {
+        if (lo >= hi) return;
+        int mid = (lo + hi) / 2;
+        if (uniform_[mid] == own || box_distance2(q, mid) > best.dist2) return;
+
+        int id = order_[mid];
+        if (node_label_[mid] != own) {
+            Edge cand{distance2(q, sorted_[mid]), std::min(self, id), std::max(self, id)};
+            if (cand < best) best = cand;
+        }
+        if (hi - lo == 1) return;
+
+        bool left_first = coord(q, axis_[mid]) < coord(sorted_[mid], axis_[mid]);
+        foreign(left_first ? lo : mid + 1, left_first ? mid : hi, self, q, own, best);
+        foreign(left_first ? mid + 1 : lo, left_first ? hi : mid, self, q, own, best);
+    }
+
+    const std::vector<Point>& points_;
+    std::vector<int> order_;
+    std::vector<int> axis_;
+    std::vector<Point> box_lo_;
+    std::vector<Point> box_hi_;
+    std::vector<Point> sorted_;    // points in tree order
+    std::vector<int> node_label_;  // labels in tree order
+    std::vector<int> uniform_;
+};
+
+// Produces every pair of points exactly once in ascending (dist2, a, b)
+// order (a < b) without materialising all n(n-1)/2 edges. Each point owns a
+// k-NN list from the k-d tree that is doubled whenever it runs out; a heap
+// merges the heads of all per-point lists. Every pair shows up in the lists
+// of both endpoints, and the two copies come out of the heap back to back,
+// so the second one is dropped. Memory is O(n * k) for the k actually used.
+class EdgeStream {
+public:
+    EdgeStream(const std::vector<Point>& points, const KdTree& tree)
+        : tree_(tree), cursors_(points.size()) {
+        for (int i = 0; i < static_cast<int>(points.size()); ++i) {
+            Cursor& cur = cursors_[i];
+            cur.k = kInitialK;
+            tree_.knn(i, cur.k, cur.neighbors);
+            push_head(i);
+        }
+    }
+
+    // Writes the next shortest edge to `e`; false once all pairs are used.
+    bool next(Edge& e) {
+        while (!heap_.empty()) {
+            Head h = heap_.top();
+            heap_.pop();
+            advance(h.owner);
+
+            Edge cand{h.dist2, h.a, h.b};
+            if (has_last_ && cand.dist2 == last_.dist2 && cand.a == last_.a && cand.b == last_.b) {
+                continue; // same pair seen from its other endpoint
+            }
+            last_ = cand;
+            has_last_ = true;
+            e = cand;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    static constexpr int kInitialK = 8;
+
+    struct Cursor {
+        std::vector<Neighbor> neighbors;
+        std::size_t pos = 0;
+        int k = 0;
+    };
+
+    struct Head {
+        ll dist2;
+        int a, b;
+        int owner;
+
+        bool operator>(const Head& o) const {
+            return std::tie(dist2, a, b) > std::tie(o.dist2, o.a, o.b);
+        }
+    };
+
+    void push_head(int owner) {
+        const Cursor& cur = cursors_[owner];
+        if (cur.pos == cur.neighbors.size()) return; // all pairs of `owner` used
+        const Neighbor& nb = cur.neighbors[cur.pos];
+        heap_.push({nb.dist2, std::min(owner, nb.idx), std::max(owner, nb.idx), owner});
+    }
+
+    void advance(int owner) {
+        Cursor& cur = cursors_[owner];
+        ++cur.pos;
+        if (cur.pos == cur.neighbors.size() && static_cast<int>(cur.neighbors.size()) == cur.k) {
+            // Ran out of precomputed neighbours: expand the search radius.
+            // The first k entries of the 2k list are the same as before.
+            cur.k *= 2;
+            tree_.knn(owner, cur.k, cur.neighbors);
+        }
+        push_head(owner);
+    }
+
+    const KdTree& tree_;
+    std::vector<Cursor> cursors_;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heap_;
+    Edge last_{};
+    bool has_last_ = false;
+};
+
+// Runs fn(t) for t in [0, threads) on separate threads and waits for all.
+template <class Fn>
+void parallel_for(unsigned threads, Fn fn) {
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(fn, t);
+    }
+    fn(0);
+    for (auto& th : pool) {
+        th.join();
+    }
+}
+
+// Stable parallel LSD radix sort of keys[0, n) on their low key_bits bits,
+// one byte per pass. Each thread histograms and scatters its own contiguous
+// slice; passes whose digit is the same for every key are skipped.
+void parallel_radix_sort(u64* keys, std::size_t n, u64* scratch, int key_bits, unsigned threads) {
+    if (n < 4096) {
+        std::sort(keys, keys + n);
+        return;
+    }
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, n / 1024));
+    threads = std::max(threads, 1u);
+
+    std::vector<std::size_t> count(static_cast<std::size_t>(threads) * 256);
+    u64* src = keys;
+    u64* dst = scratch;
+    for (int shift = 0; shift < key_bits; shift += 8) {
+        std::fill(count.begin(), count.end(), 0);
+        parallel_for(threads, [&](unsigned t) {
+            std::size_t* c = &count[t * 256];
+            for (std::size_t i = n * t / threads; i < n * (t + 1) / threads; ++i) {
+                ++c[(src[i] >> shift) & 0xFF];
+            }
+        });
+
+        // Turn the per-thread histograms into scatter offsets:
+        // bucket-major, thread-minor keeps the sort stable.
+        std::size_t total = 0;
+        bool trivial = false;
+        for (int b = 0; b < 256; ++b) {
+            std::size_t bucket = 0;
+            for (unsigned t = 0; t < threads; ++t) {
+                std::size_t c = count[t * 256 + b];
+                count[t * 256 + b] = total;
+                total += c;
+                bucket += c;
+            }
+            trivial = trivial || bucket == n;
+        }
+        if (trivial) continue; // every key has the same digit
+
+        parallel_for(threads, [&](unsigned t) {
+            std::size_t* offset = &count[t * 256];
+            for (std::size_t i = n * t / threads; i < n * (t + 1) / threads; ++i) {
+                dst[offset[(src[i] >> shift) & 0xFF]++] = src[i];
+            }
+        });
+        std::swap(src, dst);
+    }
+    if (src != keys) {
+        std::copy(src, src + n, keys);
+    }
+}
+
+// All n(n-1)/2 edges as packed 64-bit keys: dist2 in the high bits, the pair
+// index (pairs (a, b), a < b, numbered row by row) in the low bits, so key
+// order is (dist2, a, b), the same as EdgeStream. Worker threads generate the
+// keys and scatter them into 2^kBucketBits buckets by their top bits (one
+// MSD pass). Buckets are then radix sorted lazily, in order, only when the
+// consumer reaches them: the buckets holding the first K edges are sorted up
+// front for Part 1, and Part 2 pulls in the rest incrementally.
+class PackedEdgeList {
+public:
+    // Whether all pairs of these points fit the packed layout and the budget.
+    static bool fits(const std::vector<Point>& points, std::size_t max_edges) {
+        std::size_t n = points.size();
+        std::size_t m = n * (n - 1) / 2;
+        if (n < 2 || m > max_edges) return false;
+        return dist_bits(points) + index_bits(m) <= 64;
+    }
+
+    PackedEdgeList(const std::vector<Point>& points, std::size_t first_sorted)
+        : n_(points.size()),
+          m_(n_ * (n_ - 1) / 2),
+          index_bits_(index_bits(m_)),
+          key_bits_(index_bits_ + dist_bits(points)),
+          bucket_shift_(std::max(0, key_bits_ - kBucketBits)),
+          threads_(std::max(1u, std::thread::hardware_concurrency())),
+          keys_(m_),
+          scratch_(m_),
+          bucket_start_((std::size_t{1} << kBucketBits) + 1, 0) {
+        // Shard rows across threads; interleaving keeps long and short rows mixed.
+        parallel_for(threads_, [&](unsigned t) {
+            for (std::size_t i = t; i < n_; i += threads_) {
+                u64 id = row_offset(i);
+                for (std::size_t j = i + 1; j < n_; ++j, ++id) {
+                    u64 d2 = static_cast<u64>(distance2(points[i], points[j]));
+                    scratch_[id] = (d2 << index_bits_) | id;
+                }
+            }
+        });
+        scatter_into_buckets();
+
+        // Part 1 needs its first K edges in order right away
+        while (sorted_ < std::min(first_sorted, m_)) {
+            sort_next_bucket();
+        }
+    }
+
+    // Writes the next shortest edge to `e`; false once all pairs are used.
+    bool next(Edge& e) {
+        if (pos_ == m_) return false;
+        while (pos_ == sorted_) {
+            sort_next_bucket(); // Part 2 needs more edges
+        }
+        u64 key = keys_[pos_++];
+        u64 id = key & ((u64{1} << index_bits_) - 1);
+        std::size_t a = row_of(id);
+        e.dist2 = static_cast<ll>(key >> index_bits_);
+        e.a = static_cast<int>(a);
+        e.b = static_cast<int>(a + 1 + (id - row_offset(a)));
+        return true;
+    }
+
+private:
+    static int bit_width(u64 v) {
+        int bits = 0;
+        while (v != 0) {
+            ++bits;
+            v >>= 1;
+        }
+        return bits;
+    }
+
+    static int index_bits(std::size_t m) {
+        return std::max(1, bit_width(m - 1));
+    }
+
+    // Bits needed for the largest possible dist2 (the bounding-box diagonal)
+    static int dist_bits(const std::vector<Point>& points) {
+        Point lo = points[0];
+        Point hi = points[0];
+        for (const Point& p : points) {
+            lo = {std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z)};
+            hi = {std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z)};
+        }
+        return bit_width(static_cast<u64>(distance2(lo, hi)));
+    }
+
+    // Pair index of (i, i + 1)
+    u64 row_offset(std::size_t i) const {
+        return static_cast<u64>(i) * (2 * n_ - i - 1) / 2;
+    }
+
+    // Largest row i with row_offset(i) <= id
+    std::size_t row_of(u64 id) const {
+        std::size_t lo = 0;
+        std::size_t hi = n_ - 1;
+        while (lo + 1 < hi) {
+            std::size_t mid = (lo + hi) / 2;
+            if (row_offset(mid) <= id) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    // MSD pass: move the keys from scratch_ into keys_, grouped by bucket.
+    void scatter_into_buckets() {
+        const std::size_t buckets = std::size_t{1} << kBucketBits;
+        std::vector<std::size_t> count(static_cast<std::size_t>(threads_) * buckets, 0);
+        parallel_for(threads_, [&](unsigned t) {
+            std::size_t* c = &count[t * buckets];
+            for (std::size_t i = m_ * t / threads_; i < m_ * (t + 1) / threads_; ++i) {
+                ++c[scratch_[i] >> bucket_shift_];
+            }
+        });
+
+        std::size_t total = 0;
+        for (std::size_t b = 0; b < buckets; ++b) {
+            bucket_start_[b] = total;
+            for (unsigned t = 0; t < threads_; ++t) {
+                std::size_t c = count[t * buckets + b];
+                count[t * buckets + b] = total;
+                total += c;
+            }
+        }
+        bucket_start_[buckets] = total;
+
+        parallel_for(threads_, [&](unsigned t) {
+            std::size_t* offset = &count[t * buckets];
+            for (std::size_t i = m_ * t / threads_; i < m_ * (t + 1) / threads_; ++i) {
+                keys_[offset[scratch_[i] >> bucket_shift_]++] = scratch_[i];
+            }
+        });
     }
 
-    // Compute component sizes from dsu1
+    // Radix sort the next non-empty bucket; keys_[0, sorted_) is final.
+    void sort_next_bucket() {
+        std::size_t end = bucket_start_[++next_bucket_];
+        parallel_radix_sort(keys_.data() + sorted_, end - sorted_, scratch_.data(),
+                            bucket_shift_, threads_);
+        sorted_ = end;
+    }
+
+    static constexpr int kBucketBits = 12;
+
+    std::size_t n_;
+    std::size_t m_;
+    int index_bits_;
+    int key_bits_;
+    int bucket_shift_;
+    unsigned threads_;
+    std::vector<u64> keys_;
+    std::vector<u64> scratch_;
+    std::vector<std::size_t> bucket_start_;
+    std::size_t next_bucket_ = 0;
+    std::size_t sorted_ = 0;
+    std::size_t pos_ = 0;
+};
+
+// Product of the three largest component sizes (or of all, if fewer).
+ll product_of_three_largest(DSU& dsu, int n) {
     std::vector<ll> comp_sizes;
     comp_sizes.reserve(n);
     std::vector<bool> seen(n, false);
 
     for (int i = 0; i < n; ++i) {
-        int r = dsu1.find(i);
+        int r = dsu.find(i);
         if (!seen[r]) {
             seen[r] = true;
-            comp_sizes.push_back(dsu1.size[r]);
+            comp_sizes.push_back(dsu.size[r]);
         }
     }
 
     std::sort(comp_sizes.begin(), comp_sizes.end(), std::greater<ll>());
 
-    ll part1_answer = 1;
+    ll product = 1;
     if (comp_sizes.size() >= 3) {
-        part1_answer = comp_sizes[0] * comp_sizes[1] * comp_sizes[2];
+        product = comp_sizes[0] * comp_sizes[1] * comp_sizes[2];
     } else {
         // Fallback if somehow fewer than 3 components
         for (ll s : comp_sizes) {
-            part1_answer *= s;
+            product *= s;
         }
     }
+    return product;
+}
+
+// Heaviest edge of the Euclidean minimum spanning tree, i.e. the connection
+// that finally makes one circuit when pairs are taken in (dist2, a, b) order.
+// Borůvka rounds: every component picks its lightest outgoing edge and all
+// picks are merged at once, so each round at least halves the component
+// count. Edge order is total, so the picks never close a cycle. The
+// per-point searches of a round run in parallel over slices of tree order
+// and share a per-component bound, so points deep inside a component stop
+// as soon as their search radius exceeds the best pick found so far.
+// Returns an edge with a == -1 for fewer than two points.
+Edge emst_heaviest_edge(const std::vector<Point>& points, KdTree& tree, unsigned threads) {
+    const int n = static_cast<int>(points.size());
+    const ll far = std::numeric_limits<ll>::max();
+    const int unset = std::numeric_limits<int>::max();
+    Edge heaviest{-1, -1, -1};
 
-    // Part 2: continue until single circuit
-    DSU dsu2(n);
+    DSU dsu(n);
+    std::vector<int> label(n);
+    std::vector<Edge> point_best(n);
+    std::vector<Edge> comp_best(n);
+    std::vector<std::atomic<ll>> comp_bound(n);
+    const std::vector<int>& order = tree.order();
     int components = n;
 
-    int last_a = -1;
-    int last_b = -1;
+    while (components > 1) {
+        for (int i = 0; i < n; ++i) {
+            label[i] = dsu.find(i);
+            comp_bound[i].store(far, std::memory_order_relaxed);
+        }
+        tree.relabel(label);
+
+        parallel_for(threads, [&](unsigned t) {
+            std::size_t begin = order.size() * t / threads;
+            std::size_t end = order.size() * (t + 1) / threads;
+            for (std::size_t k = begin; k < end; ++k) {
+                int i = order[k];
+                std::atomic<ll>& bound = comp_bound[label[i]];
+                // A placeholder at the bound: any real edge of equal length
+                // still beats it, so the component minimum stays exact.
+                Edge best{bound.load(std::memory_order_relaxed), unset, unset};
+                tree.nearest_foreign(i, label, best);
+                point_best[i] = best;
+                if (best.a == unset) continue;
+                ll seen = bound.load(std::memory_order_relaxed);
+                while (best.dist2 < seen &&
+                       !bound.compare_exchange_weak(seen, best.dist2, std::memory_order_relaxed)) {
+                }
+            }
+        });
 
-    for (const auto& e : edges) {
-        bool merged = dsu2.unite(e.a, e.b);
-        if (merged) {
+        std::fill(comp_best.begin(), comp_best.end(), Edge{far, unset, unset});
+        for (int i = 0; i < n; ++i) {
+            if (point_best[i] < comp_best[label[i]]) comp_best[label[i]] = point_best[i];
+        }
+        for (int r = 0; r < n; ++r) {
+            const Edge& e = comp_best[r];
+            if (e.a == unset || !dsu.unite(e.a, e.b)) continue;
             --components;
-            if (components == 1) {
-                last_a = e.a;
-                last_b = e.b;
-                break;
+            if (heaviest < e) heaviest = e;
+        }
+    }
+    return heaviest;
+}
+
+// Dynamic uniform grid over the points of the online service. The cell size
+// is re-derived from the bounding box whenever the number of points doubles,
+// so cells hold O(1) points on average at amortised O(1) cost per insert.
+class GridIndex {
+public:
+    explicit GridIndex(const std::vector<Point>& points) : points_(points) {}
+
+    void insert(int id) {
+        const Point& p = points_[id];
+        if (id == 0) {
+            lo_ = hi_ = p;
+        }
+        lo_ = {std::min(lo_.x, p.x), std::min(lo_.y, p.y), std::min(lo_.z, p.z)};
+        hi_ = {std::max(hi_.x, p.x), std::max(hi_.y, p.y), std::max(hi_.z, p.z)};
+        if (id + 1 >= 2 * built_for_) {
+            rebuild(id + 1);
+        } else {
+            add_to_cell(id);
+        }
+    }
+
+    // Calls fn(q) for every indexed point q != self with dist2 <= r2.
+    template <class Fn>
+    void for_each_within(int self, ll r2, Fn fn) const {
+        const Point& p = points_[self];
+        // ceil(sqrt(r2)): the double estimate can be off by one either way
+        ll r = static_cast<ll>(std::sqrt(static_cast<double>(r2)));
+        while (r > 0 && (r - 1) * (r - 1) >= r2) --r;
+        while (r * r < r2) ++r;
+        Cell c0 = cell_of({p.x - r, p.y - r, p.z - r});
+        Cell c1 = cell_of({p.x + r, p.y + r, p.z + r});
+        for (ll cx = c0.x; cx <= c1.x; ++cx) {
+            for (ll cy = c0.y; cy <= c1.y; ++cy) {
+                for (ll cz = c0.z; cz <= c1.z; ++cz) {
+                    visit_cell({cx, cy, cz}, [&](int q) {
+                        if (q != self && distance2(p, points_[q]) <= r2) fn(q);
+                    });
+                }
+            }
+        }
+    }
+
+    // For each of the kCones direction cones around `self` (plus one for
+    // points at the same position), the nearest point in (dist2, index)
+    // order, or -1. Cells are visited in growing Chebyshev shells. A cone is
+    // settled once the shell radius covers its best candidate, or covers the
+    // whole part of the cone inside the bounding box (so boxes near the edge
+    // of the cloud don't scan everything for their empty outward cones).
+    static constexpr int kCones = 6 * 9;
+
+    std::vector<int> cone_nearest(int self) const {
+        const Point& p = points_[self];
+        std::vector<int> best(kCones + 1, -1);
+        std::vector<ll> best_d2(kCones + 1, 0);
+        auto better = [&](int cone, ll d2, int q) {
+            return best[cone] == -1 || d2 < best_d2[cone] || (d2 == best_d2[cone] && q < best[cone]);
+        };
+
+        // room[a][s]: distance from p to the bounding box along axis a in
+        // direction s (0: +, 1: -)
+        ll pc3[3] = {p.x, p.y, p.z};
+        ll lo3[3] = {lo_.x, lo_.y, lo_.z};
+        ll hi3[3] = {hi_.x, hi_.y, hi_.z};
+        ll room[3][2];
+        for (int a = 0; a < 3; ++a) {
+            room[a][0] = hi3[a] - pc3[a];
+            room[a][1] = pc3[a] - lo3[a];
+        }
+        // extent9[cone]: 9 * (largest squared distance of a bounding-box
+        // point inside the cone), bounded through the major axis offset
+        std::vector<i128> extent9(kCones + 1, 0);
+        for (int cone = 0; cone < kCones; ++cone) {
+            int face = cone / 9;
+            int axis = face / 2;
+            int sign = face % 2;
+            ll major = room[axis][sign];
+            i128 factor9 = 9;
+            int parts[2] = {(cone % 9) / 3, cone % 3};
+            for (int k = 0; k < 2; ++k) {
+                int minor_axis = (axis + 1 + k) % 3;
+                if (parts[k] == 1) {
+                    factor9 += 1; // |minor| <= major / 3
+                } else {
+                    factor9 += 9; // |minor| <= major, and |minor| >= major / 3
+                    major = std::min(major, 3 * room[minor_axis][parts[k] == 2 ? 0 : 1]);
+                }
+            }
+            extent9[cone] = static_cast<i128>(major) * major * factor9;
+        }
+
+        Cell pc = cell_of(p);
+        Cell lo = cell_of(lo_);
+        Cell hi = cell_of(hi_);
+        ll max_shell = std::max({pc.x - lo.x, hi.x - pc.x, pc.y - lo.y, hi.y - pc.y,
+                                 pc.z - lo.z, hi.z - pc.z});
+
+        for (ll s = 0; s <= max_shell; ++s) {
+            for_each_shell_cell(pc, s, [&](const Cell& c) {
+                visit_cell(c, [&](int q) {
+                    if (q == self) return;
+                    const Point& o = points_[q];
+                    int cone = cone_of(o.x - p.x, o.y - p.y, o.z - p.z);
+                    ll d2 = distance2(p, o);
+                    if (better(cone, d2, q)) {
+                        best[cone] = q;
+                        best_d2[cone] = d2;
+                    }
+                });
+            });
+
+            // Anything outside shell s is farther than s * cell_ from p.
+            i128 reach2 = static_cast<i128>(s * cell_) * (s * cell_);
+            bool done = true;
+            for (int cone = 0; cone <= kCones && done; ++cone) {
+                bool found = best[cone] != -1 && best_d2[cone] <= reach2;
+                done = found || extent9[cone] <= 9 * reach2;
             }
+            if (done) break;
         }
+        return best;
     }
 
+private:
+    struct Cell {
+        ll x, y, z;
+
+        bool operator==(const Cell& o) const { return x == o.x && y == o.y && z == o.z; }
+    };
+
+    struct CellHash {
+        std::size_t operator()(const Cell& c) const {
+            u64 h = static_cast<u64>(c.x) * 0x9E3779B97F4A7C15ULL;
+            h ^= static_cast<u64>(c.y) * 0xC2B2AE3D27D4EB4FULL + (h << 6) + (h >> 2);
+            h ^= static_cast<u64>(c.z) * 0x165667B19E3779F9ULL + (h << 6) + (h >> 2);
+            return static_cast<std::size_t>(h);
+        }
+    };
+
+    // Cone of direction (dx, dy, dz): the dominant axis and sign pick one of
+    // the six cube faces, each face is split 3 x 3 along the other two axes.
+    // Every cone is narrower than 60 degrees; kCones means "same position".
+    static int cone_of(ll dx, ll dy, ll dz) {
+        if (dx == 0 && dy == 0 && dz == 0) return kCones;
+        ll v[3] = {dx, dy, dz};
+        int axis = 0;
+        for (int a = 1; a < 3; ++a) {
+            if (std::llabs(v[a]) > std::llabs(v[axis])) axis = a;
+        }
+        ll major = std::llabs(v[axis]);
+        auto third = [major](ll minor) { return 3 * minor < -major ? 0 : (3 * minor > major ? 2 : 1); };
+        int face = 2 * axis + (v[axis] < 0 ? 1 : 0);
+        return face * 9 + third(v[(axis + 1) % 3]) * 3 + third(v[(axis + 2) % 3]);
+    }
+
+    static ll floor_div(ll a, ll b) {
+        return a / b - ((a % b != 0) && ((a < 0) != (b < 0)) ? 1 : 0);
+    }
+
+    Cell cell_of(const Point& p) const {
+        return {floor_div(p.x, cell_), floor_div(p.y, cell_), floor_div(p.z, cell_)};
+    }
+
+    template <class Fn>
+    void visit_cell(const Cell& c, Fn fn) const {
+        auto it = cells_.find(c);
+        if (it == cells_.end()) return;
+        for (int q : it->second) fn(q);
+    }
+
+    // Cells at Chebyshev distance exactly s from c
+    template <class Fn>
+    static void for_each_shell_cell(const Cell& c, ll s, Fn fn) {
+        for (ll dx = -s; dx <= s; ++dx) {
+            for (ll dy = -s; dy <= s; ++dy) {
+                bool on_face = std::llabs(dx) == s || std::llabs(dy) == s;
+                for (ll dz = -s; dz <= s; dz += (on_face || s == 0) ? 1 : 2 * s) {
+                    fn(Cell{c.x + dx, c.y + dy, c.z + dz});
+                }
+            }
+        }
+    }
+
+    void add_to_cell(int id) {
+        cells_[cell_of(points_[id])].push_back(id);
+    }
+
+    void rebuild(int count) {
+        double volume = static_cast<double>(hi_.x - lo_.x + 1) * static_cast<double>(hi_.y - lo_.y + 1) *
+                        static_cast<double>(hi_.z - lo_.z + 1);
+        // About kPerCell points per cell: fewer, fuller cells mean fewer hash
+        // lookups per shell.
+        cell_ = std::max<ll>(1, static_cast<ll>(std::cbrt(volume * kPerCell / count)));
+        built_for_ = count;
+        cells_.clear();
+        for (int id = 0; id < count; ++id) {
+            add_to_cell(id);
+        }
+    }
+
+    static constexpr double kPerCell = 8;
+
+    const std::vector<Point>& points_;
+    std::unordered_map<Cell, std::vector<int>, CellHash> cells_;
+    ll cell_ = 1;
+    int built_for_ = 0;
+    Point lo_{};
+    Point hi_{};
+};
+
+// Link-cut tree (splay-based, with path reversal). Every node has a weight
+// and an optional Edge key; each node tracks the total weight of its whole
+// represented subtree (via "virtual" children) and the node with the largest
+// key on its preferred path. All operations are amortised O(log n).
+class LinkCutTree {
+public:
+    int add_node(int weight) {
+        nodes_.push_back({});
+        Node& x = nodes_.back();
+        x.weight = x.sum = weight;
+        return static_cast<int>(nodes_.size()) - 1;
+    }
+
+    int add_key_node(const Edge& key) {
+        int id;
+        if (!free_.empty()) {
+            id = free_.back();
+            free_.pop_back();
+            nodes_[id] = {};
+        } else {
+            id = add_node(0);
+        }
+        nodes_[id].has_key = true;
+        nodes_[id].key = key;
+        nodes_[id].best = id;
+        return id;
+    }
+
+    // Recycles a key node that has already been cut from everything
+    void release(int x) { free_.push_back(x); }
+
+    const Edge& key(int x) const { return nodes_[x].key; }
+
+    bool connected(int u, int v) { return find_root(u) == find_root(v); }
+
+    // u and v must be in different trees
+    void link(int u, int v) {
+        make_root(u);
+        access(v);
+        nodes_[u].parent = v;
+        nodes_[v].virt += nodes_[u].sum;
+        pull(v);
+    }
+
+    // u and v must be adjacent
+    void cut(int u, int v) {
+        make_root(u);
+        access(v);
+        nodes_[v].ch[0] = -1;
+        nodes_[u].parent = -1;
+        pull(v);
+    }
+
+    // Key node with the largest key on the u..v path (u, v connected), or -1
+    int path_max(int u, int v) {
+        make_root(u);
+        access(v);
+        return nodes_[v].best;
+    }
+
+    // Total weight of the tree containing x
+    int tree_weight(int x) {
+        make_root(x);
+        return nodes_[x].sum;
+    }
+
+private:
+    struct Node {
+        int ch[2] = {-1, -1};
+        int parent = -1;
+        bool rev = false;
+        int weight = 0;
+        int sum = 0;  // weight of the splay subtree plus virtual subtrees
+        int virt = 0; // weight hanging off this node through path-parent links
+        bool has_key = false;
+        Edge key{};
+        int best = -1; // node with the largest key in the splay subtree
+    };
+
+    bool is_splay_root(int x) const {
+        int p = nodes_[x].parent;
+        return p == -1 || (nodes_[p].ch[0] != x && nodes_[p].ch[1] != x);
+    }
+
+    void push(int x) {
+        Node& n = nodes_[x];
+        if (!n.rev) return;
+        std::swap(n.ch[0], n.ch[1]);
+        for (int c : n.ch) {
+            if (c != -1) nodes_[c].rev = !nodes_[c].rev;
+        }
+        n.rev = false;
+    }
+
+    void pull(int x) {
+        Node& n = nodes_[x];
+        n.sum = n.weight + n.virt;
+        n.best = n.has_key ? x : -1;
+        for (int c : n.ch) {
+            if (c == -1) continue;
+            n.sum += nodes_[c].sum;
+            int b = nodes_[c].best;
+            if (b != -1 && (n.best == -1 || nodes_[n.best].key < nodes_[b].key)) {
+                n.best = b;
+            }
+        }
+    }
+
+    void rotate(int x) {
+        int p = nodes_[x].parent;
+        int g = nodes_[p].parent;
+        int dir = nodes_[p].ch[1] == x ? 1 : 0;
+        int child = nodes_[x].ch[dir ^ 1];
+
+        if (!is_splay_root(p)) {
+            nodes_[g].ch[nodes_[g].ch[1] == p ? 1 : 0] = x;
+        }
+        nodes_[x].parent = g;
+        nodes_[x].ch[dir ^ 1] = p;
+        nodes_[p].parent = x;
+        nodes_[p].ch[dir] = child;
+        if (child != -1) nodes_[child].parent = p;
+        pull(p);
+        pull(x);
+    }
+
+    void splay(int x) {
+        // Push pending reversals down from the splay root first
+        stack_.clear();
+        for (int y = x;; y = nodes_[y].parent) {
+            stack_.push_back(y);
+            if (is_splay_root(y)) break;
+        }
+        for (auto it = stack_.rbegin(); it != stack_.rend(); ++it) {
+            push(*it);
+        }
+
+        while (!is_splay_root(x)) {
+            int p = nodes_[x].parent;
+            if (!is_splay_root(p)) {
+                int g = nodes_[p].parent;
+                bool zigzig = (nodes_[g].ch[1] == p) == (nodes_[p].ch[1] == x);
+                rotate(zigzig ? p : x);
+            }
+            rotate(x);
+        }
+    }
+
+    // Makes the root..x path preferred; x ends up as the root of its splay tree
+    void access(int x) {
+        int last = -1;
+        for (int y = x; y != -1; y = nodes_[y].parent) {
+            splay(y);
+            Node& n = nodes_[y];
+            if (n.ch[1] != -1) n.virt += nodes_[n.ch[1]].sum;
+            if (last != -1) n.virt -= nodes_[last].sum;
+            n.ch[1] = last;
+            pull(y);
+            last = y;
+        }
+        splay(x);
+    }
+
+    void make_root(int x) {
+        access(x);
+        nodes_[x].rev = !nodes_[x].rev;
+        push(x);
+    }
+
+    int find_root(int x) {
+        access(x);
+        int r = x;
+        for (push(r); nodes_[r].ch[0] != -1; push(r)) {
+            r = nodes_[r].ch[0];
+        }
+        splay(r);
+        return r;
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<int> free_;
+    std::vector<int> stack_;
+};
+
+// Online version of both parts for junction boxes that arrive over time.
+// Inserting a point only looks at its neighbourhood, and both queries are
+// answered from maintained state instead of from scratch:
+//
+//  - The Euclidean MST under the (dist2, a, b) order is kept in a link-cut
+//    tree with one node per MST edge. A new point p can only have MST edges
+//    to its nearest neighbour in each cone of less than 60 degrees (any other
+//    point in the cone is strictly closer to that neighbour than to p), so
+//    those <= 55 candidates are added with the usual cycle rule: link if
+//    disconnected, otherwise replace the heaviest edge on the path if the
+//    candidate is lighter. Part 2's last connecting edge is the heaviest MST
+//    edge.
+//  - The K shortest pairs are kept in an ordered set; a new point only needs
+//    a range query out to the current K-th distance t. The circuits formed by
+//    the first K connections are exactly the components of the MST edges
+//    <= t, which a second link-cut tree tracks (with subtree sizes) as t
+//    shrinks and the MST changes. Component sizes live in a multiset, so the
+//    three largest are always at its end.
+class CircuitService {
+public:
+    explicit CircuitService(std::size_t k) : k_(k), grid_(points_) {}
+
+    void insert(const Point& p) {
+        int id = static_cast<int>(points_.size());
+        points_.push_back(p);
+        grid_.insert(id);
+        mst_vertex_.push_back(mst_.add_node(1));
+        forest_.add_node(1);
+        sizes_.insert(1);
+
+        // MST: candidate edges from the cone neighbours
+        std::vector<Edge> candidates;
+        for (int q : grid_.cone_nearest(id)) {
+            if (q != -1) candidates.push_back(make_edge(q, id));
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for (const Edge& e : candidates) {
+            add_mst_candidate(e);
+        }
+
+        // First K connections: new pairs shorter than the current K-th
+        bool was_full = full();
+        Edge old_threshold = was_full ? *shortest_.rbegin() : Edge{};
+        auto offer = [&](int q) {
+            Edge e = make_edge(q, id);
+            if (!full()) {
+                shortest_.insert(e);
+            } else if (e < *shortest_.rbegin()) {
+                shortest_.insert(e);
+                shortest_.erase(std::prev(shortest_.end()));
+            }
+        };
+        if (was_full) {
+            grid_.for_each_within(id, old_threshold.dist2, offer);
+        } else {
+            // Fewer than K pairs so far, so there are only a few points
+            for (int q = 0; q < id; ++q) offer(q);
+        }
+
+        // MST edges above the (lowered) threshold leave the circuit forest
+        if (full()) {
+            auto it = mst_edges_.upper_bound(*shortest_.rbegin());
+            auto end = was_full ? mst_edges_.upper_bound(old_threshold) : mst_edges_.end();
+            for (; it != end; ++it) {
+                forest_cut(it->first);
+            }
+        }
+    }
+
+    int size() const { return static_cast<int>(points_.size()); }
+
+    // Product of the three largest circuits after the first K connections
+    ll part1() const {
+        ll product = 1;
+        int taken = 0;
+        for (auto it = sizes_.rbegin(); it != sizes_.rend() && taken < 3; ++it, ++taken) {
+            product *= *it;
+        }
+        return product;
+    }
+
+    // Product of the X coordinates of the connection that joins everything
+    ll part2() const {
+        if (mst_edges_.empty()) return 0;
+        const Edge& e = mst_edges_.rbegin()->first;
+        return points_[e.a].x * points_[e.b].x;
+    }
+
+private:
+    Edge make_edge(int a, int b) const {
+        return {distance2(points_[a], points_[b]), std::min(a, b), std::max(a, b)};
+    }
+
+    bool full() const { return shortest_.size() >= k_; }
+
+    // Whether an MST edge is among the first K connections
+    bool in_forest(const Edge& e) const { return !full() || !(*shortest_.rbegin() < e); }
+
+    void add_mst_candidate(const Edge& e) {
+        int u = mst_vertex_[e.a];
+        int v = mst_vertex_[e.b];
+        if (mst_.connected(u, v)) {
+            int heaviest = mst_.path_max(u, v);
+            if (!(e < mst_.key(heaviest))) return;
+            remove_mst_edge(mst_.key(heaviest));
+        }
+        int node = mst_.add_key_node(e);
+        mst_.link(u, node);
+        mst_.link(node, v);
+        mst_edges_.emplace(e, node);
+        if (in_forest(e)) forest_link(e);
+    }
+
+    void remove_mst_edge(Edge e) {
+        auto it = mst_edges_.find(e);
+        int node = it->second;
+        if (in_forest(e)) forest_cut(e);
+        mst_.cut(mst_vertex_[e.a], node);
+        mst_.cut(node, mst_vertex_[e.b]);
+        mst_.release(node);
+        mst_edges_.erase(it);
+    }
+
+    void forest_link(const Edge& e) {
+        int sa = forest_.tree_weight(e.a);
+        int sb = forest_.tree_weight(e.b);
+        sizes_.erase(sizes_.find(sa));
+        sizes_.erase(sizes_.find(sb));
+        forest_.link(e.a, e.b);
+        sizes_.insert(sa + sb);
+    }
+
+    void forest_cut(const Edge& e) {
+        sizes_.erase(sizes_.find(forest_.tree_weight(e.a)));
+        forest_.cut(e.a, e.b);
+        sizes_.insert(forest_.tree_weight(e.a));
+        sizes_.insert(forest_.tree_weight(e.b));
+    }
+
+    std::size_t k_;
+    std::vector<Point> points_;
+    GridIndex grid_;
+    LinkCutTree mst_;              // vertices plus one node per MST edge
+    std::vector<int> mst_vertex_;  // point -> vertex node in mst_
+    std::map<Edge, int> mst_edges_; // MST edge -> its node in mst_
+    LinkCutTree forest_;           // MST edges within the first K connections
+    std::set<Edge> shortest_;      // the K shortest pairs
+    std::multiset<int> sizes_;     // circuit sizes
+};
+
+// Part 1: first K connections -> product of the three largest circuits.
+// Consumes the ascending edge source (EdgeStream or PackedEdgeList) only as
+// far as K edges; Part 2 comes from the spanning tree instead.
+template <class EdgeSource>
+ll connect_circuits(EdgeSource& source, int n, std::size_t K) {
+    DSU dsu(n);
+    std::size_t used = 0;
+
+    Edge e{};
+    while (used < K && source.next(e)) {
+        ++used;
+        // Even if already connected, we still "used" this pair;
+        // that's exactly how the puzzle describes it.
+        dsu.unite(e.a, e.b);
+    }
+    // Also covers fewer than K pairs existing at all
+    return product_of_three_largest(dsu, n);
+}
+
+int main(int argc, char* argv[]) {
+    // --full-edges: build and radix sort every pair instead of streaming
+    // edges from the k-d tree (pays off with many cores and small n).
+    // --online [N]: feed the boxes one at a time to the incremental
+    // CircuitService, printing both answers after every N boxes if given.
+    // --profile: per-phase hardware counters on stderr.
+    bool full_edges = false;
+    bool profile = false;
+    bool online = false;
+    long long report_every = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--full-edges") {
+            full_edges = true;
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--online") {
+            online = true;
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+                report_every = std::stoll(argv[++i]);
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--full-edges | --online [N]] [--profile]\n";
+            return 1;
+        }
+    }
+
+    PhaseProfiler profiler(profile);
+
+    std::ifstream in("input.txt");
+    if (!in) {
+        std::cerr << "Error: could not open input.txt\n";
+        return 1;
+    }
+
+    std::vector<Point> points;
+    std::string line;
+
+    // Parse lines of form "x,y,z"
+    profiler.phase("parse");
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+
+        std::stringstream ss(line);
+        ll x, y, z;
+        char c1, c2;
+        if (!(ss >> x >> c1 >> y >> c2 >> z)) {
+            continue; // malformed line
+        }
+        points.push_back({x, y, z});
+    }
+
+    int n = static_cast<int>(points.size());
+    if (n == 0) {
+        std::cout << "Part 1: 0\n";
+        std::cout << "Part 2: 0\n";
+        return 0;
+    }
+
+    const std::size_t K = 1000;
+
+    if (online) {
+        profiler.phase("online");
+        CircuitService service(K);
+        for (const Point& p : points) {
+            service.insert(p);
+            if (report_every > 0 && service.size() % report_every == 0) {
+                std::cout << "After " << service.size() << " boxes: part 1 = " << service.part1()
+                          << ", part 2 = " << service.part2() << '\n';
+            }
+        }
+        std::cout << "Part 1 (product of 3 largest circuits): " << service.part1() << '\n';
+        std::cout << "Part 2 (product of X of last connection): " << service.part2() << '\n';
+        profiler.report();
+        return 0;
+    }
+
+    // Edges come lazily from the spatial index in ascending distance order
+    // (ties broken by endpoint indices). With --full-edges, and as long as
+    // all pairs fit the packed layout and budget, they are generated and
+    // radix sorted up front instead, in the same order.
+    const std::size_t max_packed_edges = std::size_t{1} << 26;
+
+    profiler.phase("k-d tree");
+    KdTree tree(points);
+    profiler.phase("part 1");
+    ll part1_answer = 0;
+    if (full_edges && PackedEdgeList::fits(points, max_packed_edges)) {
+        PackedEdgeList edges(points, K);
+        part1_answer = connect_circuits(edges, n, K);
+    } else {
+        EdgeStream stream(points, tree);
+        part1_answer = connect_circuits(stream, n, K);
+    }
+
+    // The last connection that merges everything is the heaviest edge of the
+    // minimum spanning tree, found without enumerating edges beyond Part 1.
+    profiler.phase("part 2");
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    Edge last = emst_heaviest_edge(points, tree, threads);
+
     ll part2_answer = 0;
-    if (last_a != -1 && last_b != -1) {
-        part2_answer = points[last_a].x * points[last_b].x;
+    if (last.a != -1 && last.b != -1) {
+        part2_answer = points[last.a].x * points[last.b].x;
     }
 
     std::cout << "Part 1 (product of 3 largest circuits): " << part1_answer << '\n';
     std::cout << "Part 2 (product of X of last connection): " << part2_answer << '\n';
+    profiler.report();
 
     return 0;
 }
\ No newline at end of file
@@ -4,142 +4,880 @@
 #include <sstream>
 #include <vector>
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <tuple>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <cstring>
+
+#include "profile.h"
 
 using ll = long long;
+using i128 = __int128;
 
 struct Point {
     ll x, y;
 };
 
-// Check if point p lies on segment a-b (axis-aligned)
-bool point_on_segment(const Point& p, const Point& a, const Point& b) {
-    if (a.x == b.x) {
-        // vertical segment
-        if (p.x != a.x) return false;
-        ll ymin = std::min(a.y, b.y);
-        ll ymax = std::max(a.y, b.y);
-        return (p.y >= ymin && p.y <= ymax);
-    } else if (a.y == b.y) {
-        // horizontal segment
-        if (p.y != a.y) return false;
-        ll xmin = std::min(a.x, b.x);
-        ll xmax = std::max(a.x, b.x);
-        return (p.x >= xmin && p.x <= xmax);
-    } else {
+// Validated red-tile loop in structure-of-arrays form, shared by the
+// containment kernels: consecutive vertices (wrapping around) form
+// axis-parallel edges, no vertex repeats its predecessor or lies on a
+// straight run, and the loop is counter-clockwise.
+struct Polygon {
+    std::vector<ll> x, y;
+
+    int size() const { return static_cast<int>(x.size()); }
+};
+
+// Builds the polygon from the red tiles in input order, or explains in
+// `error` why it cannot: an edge that is not axis-parallel, an edge that
+// doubles back on the previous one, or a loop that encloses no area.
+bool build_polygon(const std::vector<Point>& reds, Polygon& poly, std::string& error) {
+    const int n = static_cast<int>(reds.size());
+    auto describe = [&](int i) {
+        return "tile " + std::to_string(i + 1) + " (" + std::to_string(reds[i].x) + "," +
+               std::to_string(reds[i].y) + ")";
+    };
+    for (int i = 0; i < n; ++i) {
+        const Point& a = reds[i];
+        const Point& b = reds[(i + 1) % n];
+        if (a.x != b.x && a.y != b.y) {
+            error = describe(i) + " and " + describe((i + 1) % n) + " are not in one row or column";
+            return false;
+        }
+    }
+
+    // Drop repeats and straight-through vertices with a stack, then repair
+    // the seam where the loop closes. `from` keeps the input position.
+    std::vector<int> kept;
+    auto straight = [&](int a, int b, int c, bool& reverses) {
+        const Point& p = reds[a];
+        const Point& q = reds[b];
+        const Point& r = reds[c];
+        bool line = (p.x == q.x && q.x == r.x) || (p.y == q.y && q.y == r.y);
+        reverses = line && (q.x - p.x) * (r.x - q.x) + (q.y - p.y) * (r.y - q.y) < 0;
+        return line;
+    };
+    auto push = [&](int c) {
+        const Point& p = reds[c];
+        if (!kept.empty() && reds[kept.back()].x == p.x && reds[kept.back()].y == p.y) return true;
+        bool reverses = false;
+        while (kept.size() >= 2 && straight(kept[kept.size() - 2], kept.back(), c, reverses)) {
+            if (reverses) {
+                error = "the loop doubles back at " + describe(kept.back());
+                return false;
+            }
+            kept.pop_back();
+        }
+        kept.push_back(c);
+        return true;
+    };
+    for (int i = 0; i < n; ++i) {
+        if (!push(i)) return false;
+    }
+    while (kept.size() >= 2 && reds[kept.back()].x == reds[kept.front()].x &&
+           reds[kept.back()].y == reds[kept.front()].y) {
+        kept.pop_back();
+    }
+    std::size_t front = 0;
+    bool changed = true;
+    while (changed && kept.size() - front >= 3) {
+        changed = false;
+        bool reverses = false;
+        if (straight(kept[kept.size() - 2], kept.back(), kept[front], reverses)) {
+            if (reverses) break;
+            kept.pop_back();
+            changed = true;
+        } else if (straight(kept.back(), kept[front], kept[front + 1], reverses)) {
+            if (reverses) break;
+            ++front;
+            changed = true;
+        }
+    }
+    bool reverses = false;
+    if (kept.size() - front >= 3 &&
+        (straight(kept[kept.size() - 2], kept.back(), kept[front], reverses) ||
+         straight(kept.back(), kept[front], kept[front + 1], reverses))) {
+        error = "the loop doubles back where it closes";
+        return false;
+    }
+    if (kept.size() - front < 4) {
+        error = "the red tiles enclose no area";
         return false;
     }
+
+    poly.x.clear();
+    poly.y.clear();
+    i128 area2 = 0;
+    for (std::size_t k = front; k < kept.size(); ++k) {
+        const Point& a = reds[kept[k]];
+        const Point& b = reds[kept[k + 1 < kept.size() ? k + 1 : front]];
+        area2 += static_cast<i128>(a.x) * b.y - static_cast<i128>(b.x) * a.y;
+        poly.x.push_back(a.x);
+        poly.y.push_back(a.y);
+    }
+    if (area2 < 0) {
+        std::reverse(poly.x.begin(), poly.x.end());
+        std::reverse(poly.y.begin(), poly.y.end());
+    }
+    return true;
 }
 
-// Ray-casting: is p inside or on boundary of orthogonal polygon poly?
-bool point_inside_or_on(const Point& p, const std::vector<Point>& poly) {
-    int n = static_cast<int>(poly.size());
+// A piece of boundary on the line u = const running from v = from to v = to,
+// in the local coordinates of one orientation.
+struct Run {
+    ll u, from, to;
+};
 
-    // First: check if on any edge -> treat as inside
-    for (int i = 0; i < n; ++i) {
-        const Point& a = poly[i];
-        const Point& b = poly[(i + 1) % n];
-        if (point_on_segment(p, a, b)) {
-            return true;
+// Axis-parallel edges of one orientation, indexed for stabbing queries. In
+// local coordinates each edge lies on the line u = const and spans [lo, hi]
+// along v; the horizontal edges are handled by a transposed instance. Along
+// v the elementary pieces are the distinct vertex coordinates (even indices)
+// and the open gaps between them (odd indices). A segment tree over pieces
+// stores each edge on its open span (lo, hi), sorted by u per node, so "the
+// first edge past u covering this piece" is an O(log^2 n) query.
+class EdgeStabber {
+    struct Edge {
+        ll u, lo, hi;
+        bool inside_behind; // the interior lies on the -u side
+    };
+
+public:
+    // Edges from the directed runs of a boundary with the interior on its
+    // left (on its right if mirrored, as transposing does). Runs on one
+    // line that overlap in opposite directions cancel, since the region
+    // lies on both sides of them.
+    EdgeStabber(const std::vector<Run>& runs, bool mirrored) {
+        // (u, v, change in upward coverage of line u at v)
+        std::vector<std::tuple<ll, ll, int>> events;
+        events.reserve(2 * runs.size());
+        for (const Run& r : runs) {
+            if (r.from == r.to) continue;
+            int up = r.to > r.from ? 1 : -1;
+            events.push_back({r.u, std::min(r.from, r.to), up});
+            events.push_back({r.u, std::max(r.from, r.to), -up});
         }
+        std::sort(events.begin(), events.end());
+        int net = 0;
+        ll open = 0;
+        for (std::size_t k = 0; k < events.size();) {
+            const ll u = std::get<0>(events[k]);
+            const ll v = std::get<1>(events[k]);
+            const int before = net;
+            for (; k < events.size() && std::get<0>(events[k]) == u && std::get<1>(events[k]) == v;
+                 ++k) {
+                net += std::get<2>(events[k]);
+            }
+            if (net == before) continue;
+            // Going towards +v with the interior on the left means the
+            // interior lies on the -u side, i.e. behind a +u ray.
+            if (before != 0) edges_.push_back({u, open, v, (before > 0) != mirrored});
+            open = v;
+        }
+
+        keys_.reserve(2 * edges_.size());
+        for (const Edge& e : edges_) {
+            keys_.push_back(e.lo);
+            keys_.push_back(e.hi);
+        }
+        std::sort(keys_.begin(), keys_.end());
+        keys_.erase(std::unique(keys_.begin(), keys_.end()), keys_.end());
+        build_tree();
     }
 
-    // Standard even/odd rule, cast ray to +x, only vertical edges matter
-    int crossings = 0;
-    for (int i = 0; i < n; ++i) {
-        const Point& a = poly[i];
-        const Point& b = poly[(i + 1) % n];
-
-        if (a.x == b.x) {
-            // Vertical edge at x = a.x, from y1 to y2
-            ll xE = a.x;
-            ll y1 = a.y;
-            ll y2 = b.y;
-            if (y1 > y2) std::swap(y1, y2);
-
-            // Check if ray from p to +x crosses this edge.
-            // We use [y1, y2) to avoid double-counting vertices.
-            if (p.y >= y1 && p.y < y2 && p.x < xE) {
-                crossings++;
+    // Calls fn(u, lo, hi) for every edge.
+    template <class Fn>
+    void for_each_edge(Fn fn) const {
+        for (const Edge& e : edges_) {
+            fn(e.u, e.lo, e.hi);
+        }
+    }
+
+    // No edge of this orientation crosses the interior of the rectangle
+    // [u1, u2] x [v1, v2] (u1 < u2, v1 < v2) from the rows just above v1 or
+    // just below v2, and the interior lies behind the first edge that a ray
+    // along v1 + 0 meets.
+    bool clear_band(ll u1, ll u2, ll v1, ll v2) const {
+        const Edge* e = first_after(piece_above(v1), u1);
+        if (!e || e->u < u2 || !e->inside_behind) return false;
+        e = first_after(piece_below(v2), u1);
+        return e && e->u >= u2;
+    }
+
+    // How far the line v = const, which must miss every vertex, stays in the
+    // region from u towards +u (forward) or -u: the distance to the first
+    // edge crossing it, or 0 if u lies outside.
+    ll room(ll v, ll u, bool forward) const {
+        const int piece = piece_at(v);
+        const Edge* e = first_after(piece, u);
+        if (!e || !e->inside_behind) return 0;
+        return forward ? e->u - u : u - first_before(piece, u)->u;
+    }
+
+private:
+    int key_index(ll v) const {
+        return static_cast<int>(std::lower_bound(keys_.begin(), keys_.end(), v) - keys_.begin());
+    }
+
+    bool is_key(int k, ll v) const { return k < static_cast<int>(keys_.size()) && keys_[k] == v; }
+
+    // The piece holding coordinate v, and the pieces just above and below it;
+    // off the keys all three are the gap containing v.
+    int piece_at(ll v) const {
+        int k = key_index(v);
+        return is_key(k, v) ? 2 * k : 2 * k - 1;
+    }
+    int piece_above(ll v) const {
+        int k = key_index(v);
+        return is_key(k, v) ? 2 * k + 1 : 2 * k - 1;
+    }
+    int piece_below(ll v) const { return 2 * key_index(v) - 1; }
+
+    void build_tree() {
+        const int pieces = 2 * static_cast<int>(keys_.size()) - 1;
+        size_ = 1;
+        while (size_ < pieces) size_ <<= 1;
+
+        // (node, edge) pairs for the canonical cover of each open span,
+        // grouped by node and sorted by u within it
+        std::vector<std::pair<int, int>> items;
+        for (int e = 0; e < static_cast<int>(edges_.size()); ++e) {
+            int l = 2 * key_index(edges_[e].lo) + 1 + size_;
+            int r = 2 * key_index(edges_[e].hi) - 1 + size_ + 1;
+            for (; l < r; l >>= 1, r >>= 1) {
+                if (l & 1) items.push_back({l++, e});
+                if (r & 1) items.push_back({--r, e});
             }
-        } else {
-            // Horizontal edge: doesn't affect vertical ray crossing in this scheme
-            continue;
+        }
+        // Edges are already sorted by u, so a stable sort on node suffices
+        std::stable_sort(items.begin(), items.end(),
+                         [](const auto& a, const auto& b) { return a.first < b.first; });
+        node_begin_.assign(2 * size_ + 1, 0);
+        for (const auto& it : items) {
+            ++node_begin_[it.first + 1];
+        }
+        for (int i = 0; i < 2 * size_; ++i) {
+            node_begin_[i + 1] += node_begin_[i];
+        }
+        node_u_.reserve(items.size());
+        node_edge_.reserve(items.size());
+        for (const auto& it : items) {
+            node_u_.push_back(edges_[it.second].u);
+            node_edge_.push_back(it.second);
         }
     }
 
-    return (crossings % 2) == 1;
-}
+    // The edge with the smallest u > after whose open span covers `piece`.
+    const Edge* first_after(int piece, ll after) const {
+        if (piece < 0 || piece >= 2 * static_cast<int>(keys_.size()) - 1) return nullptr;
+        const Edge* best = nullptr;
+        for (int node = piece + size_; node >= 1; node >>= 1) {
+            auto begin = node_u_.begin() + node_begin_[node];
+            auto end = node_u_.begin() + node_begin_[node + 1];
+            auto it = std::upper_bound(begin, end, after);
+            if (it == end) continue;
+            const Edge& e = edges_[node_edge_[it - node_u_.begin()]];
+            if (!best || e.u < best->u) best = &e;
+        }
+        return best;
+    }
 
-// Check if the rectangle [X1,X2]x[Y1,Y2] has any edge that properly crosses polygon boundary
-bool rectangle_crosses_polygon(ll X1, ll Y1, ll X2, ll Y2, const std::vector<Point>& poly) {
-    int n = static_cast<int>(poly.size());
+    // The edge with the largest u < before whose open span covers `piece`.
+    const Edge* first_before(int piece, ll before) const {
+        if (piece < 0 || piece >= 2 * static_cast<int>(keys_.size()) - 1) return nullptr;
+        const Edge* best = nullptr;
+        for (int node = piece + size_; node >= 1; node >>= 1) {
+            auto begin = node_u_.begin() + node_begin_[node];
+            auto end = node_u_.begin() + node_begin_[node + 1];
+            auto it = std::lower_bound(begin, end, before);
+            if (it == begin) continue;
+            const Edge& e = edges_[node_edge_[(it - 1) - node_u_.begin()]];
+            if (!best || e.u > best->u) best = &e;
+        }
+        return best;
+    }
 
-    for (int i = 0; i < n; ++i) {
-        Point a = poly[i];
-        Point b = poly[(i + 1) % n];
-
-        if (a.x == b.x) {
-            // Polygon edge vertical at x = a.x, y in [yA, yB]
-            ll xP = a.x;
-            ll yA = a.y;
-            ll yB = b.y;
-            if (yA > yB) std::swap(yA, yB);
-
-            // Check intersection with top edge y = Y1, x in [X1, X2]
-            // Want a "proper" intersection, not just touching at endpoints.
-            if (Y1 > yA && Y1 < yB && X1 < xP && xP < X2) {
-                return true;
+    std::vector<Edge> edges_;                 // sorted by (u, lo)
+    std::vector<ll> keys_;                    // distinct vertex v coordinates
+    int size_ = 1;
+    std::vector<int> node_begin_;
+    std::vector<ll> node_u_;
+    std::vector<int> node_edge_;
+};
+
+// Static points answering "does any lie strictly inside this rectangle" in
+// O(log^2 n): a segment tree over the points in x order, each node holding
+// the sorted y coordinates of its range.
+class PointSet {
+public:
+    explicit PointSet(std::vector<Point> points) {
+        std::sort(points.begin(), points.end(), [](const Point& a, const Point& b) {
+            return std::tie(a.x, a.y) < std::tie(b.x, b.y);
+        });
+        const int n = static_cast<int>(points.size());
+        while (size_ < n) size_ <<= 1;
+        node_y_.resize(2 * size_);
+        for (int k = 0; k < n; ++k) {
+            xs_.push_back(points[k].x);
+            node_y_[size_ + k].push_back(points[k].y);
+        }
+        for (int node = size_ - 1; node >= 1; --node) {
+            const std::vector<ll>& l = node_y_[2 * node];
+            const std::vector<ll>& r = node_y_[2 * node + 1];
+            node_y_[node].resize(l.size() + r.size());
+            std::merge(l.begin(), l.end(), r.begin(), r.end(), node_y_[node].begin());
+        }
+    }
+
+    bool any_inside(ll x1, ll x2, ll y1, ll y2) const {
+        auto rank = [&](auto it) { return size_ + static_cast<int>(it - xs_.begin()); };
+        int l = rank(std::upper_bound(xs_.begin(), xs_.end(), x1));
+        int r = rank(std::lower_bound(xs_.begin(), xs_.end(), x2));
+        auto hit = [&](int node) {
+            auto it = std::upper_bound(node_y_[node].begin(), node_y_[node].end(), y1);
+            return it != node_y_[node].end() && *it < y2;
+        };
+        for (; l < r; l >>= 1, r >>= 1) {
+            if ((l & 1) && hit(l++)) return true;
+            if ((r & 1) && hit(--r)) return true;
+        }
+        return false;
+    }
+
+private:
+    int size_ = 1;
+    std::vector<ll> xs_;
+    std::vector<std::vector<ll>> node_y_;
+};
+
+// Tile-exact containment queries for polygons too large for the compressed
+// grid. Taken as unit squares, the red/green tiles are the polygon pushed
+// outwards by half a tile; in doubled coordinates that region is bounded by
+// the loop through the vertices moved one unit diagonally outwards, with
+// vertical edges in one stabbing index and horizontal ones in a transposed
+// one. Where two parallel edges are one tile apart their pushed copies meet
+// and cancel, which can cut off holes, so one vertex of every separate
+// piece of boundary is kept to reject rectangles enclosing a whole piece.
+class EdgeIndex {
+public:
+    explicit EdgeIndex(const Polygon& poly)
+        : vertical_(runs(poly, false), false), horizontal_(runs(poly, true), true),
+          pieces_(piece_corners()) {}
+
+    // Whether the rectangle with red tiles a and b as opposite corners is
+    // made only of red/green tiles.
+    bool rectangle_inside(const Point& a, const Point& b) const {
+        ll X1 = 2 * std::min(a.x, b.x) - 1;
+        ll X2 = 2 * std::max(a.x, b.x) + 1;
+        ll Y1 = 2 * std::min(a.y, b.y) - 1;
+        ll Y2 = 2 * std::max(a.y, b.y) + 1;
+        return vertical_.clear_band(X1, X2, Y1, Y2) && horizontal_.clear_band(Y1, Y2, X1, X2) &&
+               !pieces_.any_inside(X1, X2, Y1, Y2);
+    }
+
+    // How far the red/green tiles extend from tile p along its row and
+    // column, as tiles beyond p towards {-x, +x, -y, +y}. Tile centres have
+    // even doubled coordinates and the boundary odd ones, so the lines
+    // through them miss every vertex.
+    std::array<ll, 4> reach(const Point& p) const {
+        const ll x = 2 * p.x;
+        const ll y = 2 * p.y;
+        if (vertical_.room(y, x, true) == 0) return {0, 0, 0, 0};
+        return {(vertical_.room(y, x, false) - 1) / 2, (vertical_.room(y, x, true) - 1) / 2,
+                (horizontal_.room(x, y, false) - 1) / 2, (horizontal_.room(x, y, true) - 1) / 2};
+    }
+
+private:
+    // The pushed-out loop in doubled coordinates, as runs along the edges
+    // of one orientation (horizontal ones, transposed, if transpose is set)
+    static std::vector<Run> runs(const Polygon& poly, bool transpose) {
+        const int n = poly.size();
+        auto sign = [](ll d) { return d > 0 ? 1 : d < 0 ? -1 : 0; };
+        // The polygon is counter-clockwise, so outwards is to the right of
+        // each edge, and a vertex moves out along both of its edges.
+        std::vector<Point> moved(n);
+        for (int i = 0; i < n; ++i) {
+            int prev = (i + n - 1) % n;
+            int next = (i + 1) % n;
+            const int right_x = sign(poly.y[i] - poly.y[prev]) + sign(poly.y[next] - poly.y[i]);
+            const int right_y = -sign(poly.x[i] - poly.x[prev]) - sign(poly.x[next] - poly.x[i]);
+            moved[i] = {2 * poly.x[i] + right_x, 2 * poly.y[i] + right_y};
+        }
+        std::vector<Run> out;
+        for (int i = 0; i < n; ++i) {
+            const Point& a = moved[i];
+            const Point& b = moved[(i + 1) % n];
+            if (!transpose && poly.x[i] == poly.x[(i + 1) % n]) out.push_back({a.x, a.y, b.y});
+            if (transpose && poly.y[i] == poly.y[(i + 1) % n]) out.push_back({a.y, a.x, b.x});
+        }
+        return out;
+    }
+
+    // One vertex of each connected piece of the boundary
+    std::vector<Point> piece_corners() const {
+        std::vector<Point> corners;
+        vertical_.for_each_edge([&](ll u, ll lo, ll hi) {
+            corners.push_back({u, lo});
+            corners.push_back({u, hi});
+        });
+        auto less = [](const Point& a, const Point& b) {
+            return std::tie(a.x, a.y) < std::tie(b.x, b.y);
+        };
+        auto same = [](const Point& a, const Point& b) { return a.x == b.x && a.y == b.y; };
+        std::sort(corners.begin(), corners.end(), less);
+        corners.erase(std::unique(corners.begin(), corners.end(), same), corners.end());
+        auto id = [&](ll x, ll y) {
+            auto it = std::lower_bound(corners.begin(), corners.end(), Point{x, y}, less);
+            return static_cast<int>(it - corners.begin());
+        };
+        std::vector<int> parent(corners.size());
+        for (std::size_t k = 0; k < parent.size(); ++k) {
+            parent[k] = static_cast<int>(k);
+        }
+        auto find = [&](int k) {
+            while (parent[k] != k) k = parent[k] = parent[parent[k]];
+            return k;
+        };
+        vertical_.for_each_edge(
+            [&](ll u, ll lo, ll hi) { parent[find(id(u, lo))] = find(id(u, hi)); });
+        horizontal_.for_each_edge(
+            [&](ll u, ll lo, ll hi) { parent[find(id(lo, u))] = find(id(hi, u)); });
+        std::vector<Point> out;
+        for (std::size_t k = 0; k < parent.size(); ++k) {
+            if (find(static_cast<int>(k)) == static_cast<int>(k)) out.push_back(corners[k]);
+        }
+        return out;
+    }
+
+    EdgeStabber vertical_;
+    EdgeStabber horizontal_;
+    PointSet pieces_; // one corner per piece of boundary
+};
+
+// Tile-exact containment on a compressed grid. The breakpoints along each
+// axis are every vertex coordinate v and v + 1, so each compressed cell is a
+// block of tiles that are either all red/green or all outside; a cell is
+// classified by its lowest tile. A 2D prefix sum over outside cells then
+// answers "is every tile of this rectangle red or green" in O(1).
+class ContainmentGrid {
+public:
+    // Whether the compressed grid for poly stays within max_cells cells.
+    static bool fits(const Polygon& poly, std::size_t max_cells) {
+        std::size_t cols = breakpoints(poly.x).size();
+        std::size_t rows = breakpoints(poly.y).size();
+        return cols * rows <= max_cells;
+    }
+
+    // Grid for poly, answering queries about rectangles between corners,
+    // which must lie within the polygon's bounding box.
+    ContainmentGrid(const Polygon& poly, const std::vector<Point>& corners)
+        : xs_(breakpoints(poly.x)), ys_(breakpoints(poly.y)),
+          corners_(corners), col_(corners.size()), row_(corners.size()) {
+        for (std::size_t i = 0; i < corners.size(); ++i) {
+            col_[i] = cell_of(xs_, corners[i].x);
+            row_[i] = cell_of(ys_, corners[i].y);
+        }
+        const int n = poly.size();
+        std::vector<int> vcol(n), vrow(n);
+        for (int i = 0; i < n; ++i) {
+            vcol[i] = cell_of(xs_, poly.x[i]);
+            vrow[i] = cell_of(ys_, poly.y[i]);
+        }
+
+        const std::size_t C = xs_.size();
+        const std::size_t R = ys_.size();
+        std::vector<std::uint8_t> good(C * R, 0);
+        std::vector<std::uint8_t> toggle(C * R, 0);
+
+        for (int i = 0; i < n; ++i) {
+            int j = (i + 1) % n;
+            if (poly.x[i] == poly.x[j]) {
+                // Vertical edge: boundary cells, and a parity toggle for the
+                // rows of tiles in [y1, y2), as in the ray-casting rule
+                int c = vcol[i];
+                int r1 = std::min(vrow[i], vrow[j]);
+                int r2 = std::max(vrow[i], vrow[j]);
+                for (int r = r1; r <= r2; ++r) {
+                    good[r * C + c] = 1;
+                    if (r < r2) toggle[r * C + c] ^= 1;
+                }
+            } else {
+                int r = vrow[i];
+                int c1 = std::min(vcol[i], vcol[j]);
+                int c2 = std::max(vcol[i], vcol[j]);
+                for (int c = c1; c <= c2; ++c) {
+                    good[r * C + c] = 1;
+                }
             }
-            // Bottom edge y = Y2
-            if (Y2 > yA && Y2 < yB && X1 < xP && xP < X2) {
-                return true;
+        }
+
+        // A tile is inside when an odd number of vertical edges lie at or
+        // left of it; each row has an even total, so this matches a ray to +x.
+        for (std::size_t r = 0; r < R; ++r) {
+            std::uint8_t parity = 0;
+            for (std::size_t c = 0; c < C; ++c) {
+                parity ^= toggle[r * C + c];
+                good[r * C + c] |= parity;
             }
-        } else if (a.y == b.y) {
-            // Polygon edge horizontal at y = a.y, x in [xA, xB]
-            ll yP = a.y;
-            ll xA = a.x;
-            ll xB = b.x;
-            if (xA > xB) std::swap(xA, xB);
-
-            // Check intersection with left edge x = X1, y in [Y1, Y2]
-            if (X1 > xA && X1 < xB && Y1 < yP && yP < Y2) {
-                return true;
+        }
+
+        // outside_[(r + 1) * (C + 1) + (c + 1)] = outside cells in [0, r] x [0, c]
+        outside_.assign((R + 1) * (C + 1), 0);
+        for (std::size_t r = 0; r < R; ++r) {
+            for (std::size_t c = 0; c < C; ++c) {
+                outside_[(r + 1) * (C + 1) + (c + 1)] =
+                    outside_[r * (C + 1) + (c + 1)] + outside_[(r + 1) * (C + 1) + c] -
+                    outside_[r * (C + 1) + c] + (good[r * C + c] ? 0 : 1);
+            }
+        }
+    }
+
+    // Whether the rectangle with corners i and j as opposite corners is
+    // made only of red/green tiles.
+    bool rectangle_inside(int i, int j) const {
+        return outside_in(std::min(row_[i], row_[j]), std::max(row_[i], row_[j]) + 1,
+                          std::min(col_[i], col_[j]), std::max(col_[i], col_[j]) + 1) == 0;
+    }
+
+    // How far the red/green tiles extend from corner i along its row and
+    // column, as tiles beyond it towards {-x, +x, -y, +y}. Each direction
+    // is a binary search for the longest run of cells free of outside ones.
+    std::array<ll, 4> reach(int i) const {
+        const int c = col_[i];
+        const int r = row_[i];
+        const int C = static_cast<int>(xs_.size());
+        const int R = static_cast<int>(ys_.size());
+        auto row_clear = [&](int c1, int c2) { return outside_in(r, r + 1, c1, c2 + 1) == 0; };
+        auto col_clear = [&](int r1, int r2) { return outside_in(r1, r2 + 1, c, c + 1) == 0; };
+        if (!row_clear(c, c)) return {0, 0, 0, 0};
+
+        // Furthest cell k from `from` towards `limit` with clear(from..k);
+        // `bad` is the nearest cell known not to qualify
+        auto furthest = [](int from, int limit, auto clear) {
+            int good = from;
+            int bad = limit + (limit >= from ? 1 : -1);
+            while (std::abs(bad - good) > 1) {
+                int mid = good + (bad - good) / 2;
+                if (clear(std::min(from, mid), std::max(from, mid))) {
+                    good = mid;
+                } else {
+                    bad = mid;
+                }
             }
-            // Right edge x = X2
-            if (X2 > xA && X2 < xB && Y1 < yP && yP < Y2) {
-                return true;
+            return good;
+        };
+        const ll x = corners_[i].x;
+        const ll y = corners_[i].y;
+        return {x - xs_[furthest(c, 0, row_clear)],
+                xs_[furthest(c, C - 2, row_clear) + 1] - 1 - x,
+                y - ys_[furthest(r, 0, col_clear)],
+                ys_[furthest(r, R - 2, col_clear) + 1] - 1 - y};
+    }
+
+private:
+    // Outside cells in rows [r1, r2) and columns [c1, c2)
+    std::uint32_t outside_in(std::size_t r1, std::size_t r2, std::size_t c1, std::size_t c2) const {
+        const std::size_t W = xs_.size() + 1;
+        return outside_[r2 * W + c2] - outside_[r1 * W + c2] - outside_[r2 * W + c1] +
+               outside_[r1 * W + c1];
+    }
+
+    static std::vector<ll> breakpoints(const std::vector<ll>& coords) {
+        std::vector<ll> v;
+        v.reserve(2 * coords.size());
+        for (ll c : coords) {
+            v.push_back(c);
+            v.push_back(c + 1);
+        }
+        std::sort(v.begin(), v.end());
+        v.erase(std::unique(v.begin(), v.end()), v.end());
+        return v;
+    }
+
+    // Compressed cell holding coordinate value (cells are homogeneous, so a
+    // corner inside one stands for the whole cell)
+    static int cell_of(const std::vector<ll>& v, ll value) {
+        return static_cast<int>(std::upper_bound(v.begin(), v.end(), value) - v.begin()) - 1;
+    }
+
+    std::vector<ll> xs_, ys_;
+    std::vector<Point> corners_;
+    std::vector<int> col_, row_;         // compressed column/row of each corner
+    std::vector<std::uint32_t> outside_; // 2D prefix sum of outside cells
+};
+
+// Area in tiles of the rectangle with a and b as opposite corners.
+ll tile_area(const Point& a, const Point& b) {
+    return (std::llabs(a.x - b.x) + 1) * (std::llabs(a.y - b.y) + 1);
+}
+
+// Largest tile_area(l, u) with l on the lower-left staircase and u on the
+// upper-right one; any other pair with u up and right of l is dominated.
+// Both staircases run with x ascending and y descending, and the best
+// partner index is monotone in l, so divide and conquer over l needs
+// O(k log k) evaluations ("money for nothing").
+ll staircase_max(const std::vector<Point>& pts) {
+    std::vector<Point> sorted = pts;
+    std::sort(sorted.begin(), sorted.end(),
+              [](const Point& a, const Point& b) { return std::tie(a.x, a.y) < std::tie(b.x, b.y); });
+
+    std::vector<Point> lower; // Pareto-minimal points
+    for (const Point& p : sorted) {
+        if (lower.empty() || p.y < lower.back().y) lower.push_back(p);
+    }
+    std::vector<Point> upper; // Pareto-maximal points, collected right to left
+    for (auto it = sorted.rbegin(); it != sorted.rend(); ++it) {
+        if (upper.empty() || it->y > upper.back().y) upper.push_back(*it);
+    }
+    std::reverse(upper.begin(), upper.end());
+
+    // Negative when u is left of or below l in one axis only; pairs with u
+    // down-left of l in both would look positive and are excluded.
+    auto value = [&](const Point& l, const Point& u) {
+        ll w = u.x - l.x + 1;
+        ll h = u.y - l.y + 1;
+        if (w <= 0 && h <= 0) return std::numeric_limits<ll>::min();
+        return w * h;
+    };
+
+    ll best = 0;
+    auto solve = [&](auto&& self, int lo, int hi, int opt_lo, int opt_hi) -> void {
+        if (lo > hi) return;
+        int mid = (lo + hi) / 2;
+        int arg = opt_lo;
+        ll mid_best = std::numeric_limits<ll>::min();
+        for (int k = opt_lo; k <= opt_hi; ++k) {
+            ll v = value(lower[mid], upper[k]);
+            if (v > mid_best) {
+                mid_best = v;
+                arg = k;
             }
         }
+        best = std::max(best, mid_best);
+        self(self, lo, mid - 1, opt_lo, arg);
+        self(self, mid + 1, hi, arg, opt_hi);
+    };
+    solve(solve, 0, static_cast<int>(lower.size()) - 1, 0, static_cast<int>(upper.size()) - 1);
+    return best;
+}
+
+// Part 1: the largest rectangle spans either the lower-left and upper-right
+// staircases or, after mirroring y, the upper-left and lower-right ones.
+ll largest_rectangle(const std::vector<Point>& reds) {
+    std::vector<Point> mirrored = reds;
+    for (Point& p : mirrored) {
+        p.y = -p.y;
     }
+    return std::max(staircase_max(reds), staircase_max(mirrored));
+}
 
-    return false;
+// Runs fn(t) for t in [0, threads) on separate threads and waits for all.
+template <class Fn>
+void parallel_for(unsigned threads, Fn fn) {
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(fn, t);
+    }
+    fn(0);
+    for (auto& th : pool) {
+        th.join();
+    }
 }
 
-// Check if rectangle with corners (X1,Y1) and (X2,Y2) is fully inside polygon (including boundary)
-bool rectangle_inside_polygon(ll X1, ll Y1, ll X2, ll Y2, const std::vector<Point>& poly) {
-    // Normalize ordering
-    if (X1 > X2) std::swap(X1, X2);
-    if (Y1 > Y2) std::swap(Y1, Y2);
+// Static 2-d tree over the red tiles, searched for the partners of one tile
+// in Part 2. Tile j can only pair with tile i if each lies in the other's
+// row and column runs (j's runs are x in [x_j - r0, x_j + r1] and y in
+// [y_j - r2, y_j + r3], from its reach). A node keeps the bounding box of
+// its tiles, the hull of their runs and the range of their bounds, so
+// subtrees that cannot hold a valid partner, or one better than the best
+// area so far, are skipped whole.
+class PartnerTree {
+    struct Node {
+        ll x0, x1, y0, y1;                 // bounding box of the tiles
+        ll run_x0, run_x1, run_y0, run_y1; // hull of their runs
+        ll min_bound, max_bound;
+        int begin, end; // tiles ids_[begin, end)
+        int left = -1;  // children, -1 for a leaf
+        int right = -1;
+    };
+
+public:
+    PartnerTree(const std::vector<Point>& reds, const std::vector<std::array<ll, 4>>& reach,
+                const std::vector<ll>& bound)
+        : reds_(reds), reach_(reach), bound_(bound), ids_(reds.size()) {
+        for (std::size_t i = 0; i < ids_.size(); ++i) {
+            ids_[i] = static_cast<int>(i);
+        }
+        nodes_.reserve(4 * ids_.size() / kLeaf + 1);
+        build(0, static_cast<int>(ids_.size()), true);
+    }
 
-    // Corner points
-    Point p1{X1, Y1};
-    Point p2{X1, Y2};
-    Point p3{X2, Y1};
-    Point p4{X2, Y2};
+    // Calls offer(j, area) for every valid partner j of tile i with a bound
+    // no larger than i's (the others find i themselves) and an area above
+    // best, from the most promising subtrees down.
+    template <class Offer>
+    void search(int i, const std::atomic<ll>& best, Offer offer) const {
+        if (potential(nodes_[0], i) > best.load(std::memory_order_relaxed)) {
+            visit(0, i, best, offer);
+        }
+    }
 
-    // 1) All corners must be inside or on boundary
-    if (!point_inside_or_on(p1, poly)) return false;
-    if (!point_inside_or_on(p2, poly)) return false;
-    if (!point_inside_or_on(p3, poly)) return false;
-    if (!point_inside_or_on(p4, poly)) return false;
+private:
+    static constexpr int kLeaf = 8;
+
+    int build(int begin, int end, bool by_x) {
+        Node node{};
+        node.begin = begin;
+        node.end = end;
+        const ll lowest = std::numeric_limits<ll>::min();
+        const ll highest = std::numeric_limits<ll>::max();
+        node.x0 = node.y0 = node.run_x0 = node.run_y0 = node.min_bound = highest;
+        node.x1 = node.y1 = node.run_x1 = node.run_y1 = node.max_bound = lowest;
+        for (int k = begin; k < end; ++k) {
+            const Point& p = reds_[ids_[k]];
+            const auto& r = reach_[ids_[k]];
+            node.x0 = std::min(node.x0, p.x);
+            node.x1 = std::max(node.x1, p.x);
+            node.y0 = std::min(node.y0, p.y);
+            node.y1 = std::max(node.y1, p.y);
+            node.run_x0 = std::min(node.run_x0, p.x - r[0]);
+            node.run_x1 = std::max(node.run_x1, p.x + r[1]);
+            node.run_y0 = std::min(node.run_y0, p.y - r[2]);
+            node.run_y1 = std::max(node.run_y1, p.y + r[3]);
+            node.min_bound = std::min(node.min_bound, bound_[ids_[k]]);
+            node.max_bound = std::max(node.max_bound, bound_[ids_[k]]);
+        }
+        const int index = static_cast<int>(nodes_.size());
+        nodes_.push_back(node);
+        if (end - begin > kLeaf) {
+            // Split at the median, alternating axes unless the node is flat
+            if (by_x ? node.x0 == node.x1 : node.y0 == node.y1) by_x = !by_x;
+            const int mid = begin + (end - begin) / 2;
+            std::nth_element(ids_.begin() + begin, ids_.begin() + mid, ids_.begin() + end,
+                             [&](int a, int b) {
+                                 return by_x ? reds_[a].x < reds_[b].x : reds_[a].y < reds_[b].y;
+                             });
+            const int left = build(begin, mid, !by_x);
+            const int right = build(mid, end, !by_x);
+            nodes_[index].left = left;
+            nodes_[index].right = right;
+        }
+        return index;
+    }
 
-    // 2) No rectangle edge may properly cross the polygon boundary
-    if (rectangle_crosses_polygon(X1, Y1, X2, Y2, poly)) return false;
+    // Largest area a tile of the node could reach as i's partner, or 0
+    ll potential(const Node& node, int i) const {
+        const Point& p = reds_[i];
+        const auto& r = reach_[i];
+        if (node.min_bound > bound_[i] || p.x < node.run_x0 || p.x > node.run_x1 ||
+            p.y < node.run_y0 || p.y > node.run_y1) {
+            return 0;
+        }
+        ll x0 = std::max(node.x0, p.x - r[0]);
+        ll x1 = std::min(node.x1, p.x + r[1]);
+        ll y0 = std::max(node.y0, p.y - r[2]);
+        ll y1 = std::min(node.y1, p.y + r[3]);
+        if (x0 > x1 || y0 > y1) return 0;
+        ll area = (std::max(p.x - x0, x1 - p.x) + 1) * (std::max(p.y - y0, y1 - p.y) + 1);
+        return std::min(area, node.max_bound);
+    }
 
-    return true;
+    template <class Offer>
+    void visit(int index, int i, const std::atomic<ll>& best, Offer& offer) const {
+        const Node& node = nodes_[index];
+        if (node.left == -1) {
+            const Point& p = reds_[i];
+            const auto& r = reach_[i];
+            for (int k = node.begin; k < node.end; ++k) {
+                const int j = ids_[k];
+                const Point& q = reds_[j];
+                const auto& s = reach_[j];
+                if (j == i || bound_[j] > bound_[i] || q.x < p.x - r[0] || q.x > p.x + r[1] ||
+                    q.y < p.y - r[2] || q.y > p.y + r[3] || p.x < q.x - s[0] || p.x > q.x + s[1] ||
+                    p.y < q.y - s[2] || p.y > q.y + s[3]) {
+                    continue;
+                }
+                ll area = tile_area(p, q);
+                if (area > best.load(std::memory_order_relaxed)) offer(j, area);
+            }
+            return;
+        }
+        int first = node.left;
+        int second = node.right;
+        ll first_potential = potential(nodes_[first], i);
+        ll second_potential = potential(nodes_[second], i);
+        if (second_potential > first_potential) {
+            std::swap(first, second);
+            std::swap(first_potential, second_potential);
+        }
+        if (first_potential > best.load(std::memory_order_relaxed)) visit(first, i, best, offer);
+        if (second_potential > best.load(std::memory_order_relaxed)) visit(second, i, best, offer);
+    }
+
+    const std::vector<Point>& reds_;
+    const std::vector<std::array<ll, 4>>& reach_;
+    const std::vector<ll>& bound_;
+    std::vector<int> ids_; // tile indices, grouped by node
+    std::vector<Node> nodes_;
+};
+
+// Part 2: largest rectangle between two red tiles for which inside(i, j)
+// holds. A rectangle with corner i cannot be wider or taller than the
+// polygon's reach from i along its row and column, which bounds each tile;
+// tiles are taken in descending bound until that cannot beat the best
+// found, and each searches a PartnerTree for partners with a smaller bound.
+// Tiles are handed to threads one at a time and share the best through an
+// atomic, which also skips the containment test for pairs that cannot
+// improve it.
+template <class Inside>
+ll largest_inside_rectangle(const std::vector<Point>& reds,
+                            const std::vector<std::array<ll, 4>>& reach, const Inside& inside,
+                            unsigned threads) {
+    const int n = static_cast<int>(reds.size());
+    std::vector<ll> bound(n);
+    for (int i = 0; i < n; ++i) {
+        const auto& r = reach[i];
+        bound[i] = (std::max(r[0], r[1]) + 1) * (std::max(r[2], r[3]) + 1);
+    }
+    std::vector<int> order(n);
+    for (int i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return bound[a] > bound[b]; });
+    const PartnerTree partners(reds, reach, bound);
+
+    std::atomic<ll> best{0};
+    std::atomic<int> next{0};
+    parallel_for(threads, [&](unsigned) {
+        for (int a = next++; a < n; a = next++) {
+            int i = order[a];
+            if (bound[i] <= best.load(std::memory_order_relaxed)) break;
+            partners.search(i, best, [&](int j, ll area) {
+                if (!inside(i, j)) return;
+                ll seen = best.load(std::memory_order_relaxed);
+                while (area > seen &&
+                       !best.compare_exchange_weak(seen, area, std::memory_order_relaxed)) {
+                }
+            });
+        }
+    });
+    return best.load();
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // --profile: per-phase hardware counters on stderr
+    // --edges: answer Part 2 from the edge index even when the grid fits
+    bool profile = false;
+    bool force_edges = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0) profile = true;
+        if (std::strcmp(argv[i], "--edges") == 0) force_edges = true;
+    }
+    PhaseProfiler profiler(profile);
+
     std::ifstream in("input.txt");
     if (!in) {
         std::cerr << "Error: could not open input.txt\n";
@@ -150,6 +888,7 @@ int main() {
     std::string line;
 
     // Input lines "x,y" in polygon order
+    profiler.phase("parse");
     while (std::getline(in, line)) {
         if (line.empty()) continue;
         std::stringstream ss(line);
@@ -168,44 +907,55 @@ int main() {
         return 0;
     }
 
+    // Reject malformed loops before any search; straight-through and
+    // repeated tiles stay candidates but are not polygon vertices.
+    profiler.phase("polygon");
+    Polygon poly;
+    std::string error;
+    if (!build_polygon(reds, poly, error)) {
+        std::cerr << "Error: invalid polygon: " << error << '\n';
+        return 1;
+    }
+
     // Part 1: largest rectangle using any two red tiles as opposite corners,
     // ignoring interior content.
-    ll best_part1 = 0;
+    profiler.phase("part 1");
+    ll best_part1 = largest_rectangle(reds);
 
     // Part 2: largest rectangle that is fully within the red+green region,
     // i.e., fully inside or on the polygon formed by reds in input order.
+    // Uses the compressed prefix-sum grid when it fits the budget, otherwise
+    // the edge stabbing index.
+    const std::size_t max_grid_cells = std::size_t{1} << 24;
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+    profiler.phase("index");
+    // The reach bound comes from the same index as the containment test, so
+    // it never cuts off a rectangle that test would accept.
+    std::vector<std::array<ll, 4>> reach(n);
     ll best_part2 = 0;
-
-    for (int i = 0; i < n; ++i) {
-        for (int j = i + 1; j < n; ++j) {
-            ll x1 = reds[i].x;
-            ll y1 = reds[i].y;
-            ll x2 = reds[j].x;
-            ll y2 = reds[j].y;
-
-            ll dx = std::llabs(x2 - x1);
-            ll dy = std::llabs(y2 - y1);
-
-            ll width  = dx + 1;
-            ll height = dy + 1;
-            ll area   = width * height;
-
-            // Part 1
-            if (area > best_part1) {
-                best_part1 = area;
-            }
-
-            // Part 2: only if rectangle is fully inside/on polygon
-            if (area > best_part2) {
-                if (rectangle_inside_polygon(x1, y1, x2, y2, reds)) {
-                    best_part2 = area;
-                }
-            }
+    if (!force_edges && ContainmentGrid::fits(poly, max_grid_cells)) {
+        ContainmentGrid grid(poly, reds);
+        for (int i = 0; i < n; ++i) {
+            reach[i] = grid.reach(i);
+        }
+        profiler.phase("part 2");
+        best_part2 = largest_inside_rectangle(
+            reds, reach, [&](int i, int j) { return grid.rectangle_inside(i, j); }, threads);
+    } else {
+        EdgeIndex edges(poly);
+        for (int i = 0; i < n; ++i) {
+            reach[i] = edges.reach(reds[i]);
         }
+        profiler.phase("part 2");
+        best_part2 = largest_inside_rectangle(
+            reds, reach, [&](int i, int j) { return edges.rectangle_inside(reds[i], reds[j]); },
+            threads);
     }
 
     std::cout << "Part 1 (any tiles inside):     " << best_part1 << '\n';
     std::cout << "Part 2 (only red/green tiles): " << best_part2 << '\n';
+    profiler.report();
 
     return 0;
 }
\ No newline at end of file
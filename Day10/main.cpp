@@ -1,126 +1,1030 @@
 #include <fstream>
 #include <iostream>
 #include <string>
-#include <sstream>
+#include <string_view>
 #include <vector>
-#include <queue>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
 
-int main() {
-    std::ifstream in("input.txt");
-    if (!in) {
-        std::cerr << "Error: could not open input.txt\n";
-        return 1;
-    }
+#include "profile.h"
 
-    long long total_presses = 0; // sum over all machines
-    std::string line;
+using u64 = std::uint64_t;
 
-    while (std::getline(in, line)) {
-        // Skip empty lines
-        if (line.empty()) continue;
+// One machine line: the indicator pattern, what each button is wired to,
+// and the joltage each counter must reach.
+struct Machine {
+    std::vector<std::uint8_t> target;      // 1 where light i must end up on
+    std::vector<std::vector<int>> buttons; // lights toggled by each button
+    std::vector<int> joltage;              // required count per counter
+};
 
-        // Step 1 Extract the indicator pattern inside [ ... ]
-        std::size_t lb = line.find('[');
-        std::size_t rb = line.find(']', lb + 1);
-        if (lb == std::string::npos || rb == std::string::npos || rb <= lb + 1) {
-            // malformed line, skip
+// Calls fn for every non-negative integer in a list such as "0,1,2".
+// Returns false, after the numbers before it, on one that does not fit in
+// an int.
+template <class Fn>
+bool for_each_number(std::string_view list, Fn fn) {
+    std::size_t i = 0;
+    while (i < list.size()) {
+        if (list[i] < '0' || list[i] > '9') {
+            ++i;
             continue;
         }
+        int value = 0;
+        while (i < list.size() && list[i] >= '0' && list[i] <= '9') {
+            if (value > (std::numeric_limits<int>::max() - (list[i] - '0')) / 10) return false;
+            value = value * 10 + (list[i] - '0');
+            ++i;
+        }
+        fn(value);
+    }
+    return true;
+}
 
-        std::string pattern = line.substr(lb + 1, rb - lb - 1);
-        int nLights = static_cast<int>(pattern.size());
+// Parses "[.##.] (3) (1,3) ... {...}". Returns false for malformed lines,
+// including numbers too large for an int.
+// The vectors of m keep their capacity between calls, so a reused Machine
+// stops allocating once it has seen the largest line.
+bool parse_machine(std::string_view line, Machine& m) {
+    // Step 1 Extract the indicator pattern inside [ ... ]
+    std::size_t lb = line.find('[');
+    std::size_t rb = line.find(']', lb + 1);
+    if (lb == std::string_view::npos || rb == std::string_view::npos || rb <= lb + 1) {
+        return false;
+    }
 
-        if (nLights == 0) {
-            // No lights? Then no presses needed.
-            continue;
+    // '#' -> 1, '.' -> 0, light i counted from the left
+    m.target.clear();
+    for (std::size_t i = lb + 1; i < rb; ++i) {
+        m.target.push_back(line[i] == '#' ? 1 : 0);
+    }
+    const int nLights = static_cast<int>(m.target.size());
+
+    // Step 2 Extract buttons from ( ... ) BEFORE the { ... } block
+    std::size_t count = 0;
+    std::size_t bracePos = line.find('{', rb + 1);
+    std::size_t searchEnd = (bracePos == std::string_view::npos) ? line.size() : bracePos;
+
+    std::size_t pos = rb + 1;
+    while (true) {
+        std::size_t lp = line.find('(', pos);
+        if (lp == std::string_view::npos || lp >= searchEnd) break;
+        std::size_t rp = line.find(')', lp + 1);
+        if (rp == std::string_view::npos || rp > searchEnd) break;
+
+        if (count == m.buttons.size()) m.buttons.emplace_back();
+        std::vector<int>& lights = m.buttons[count++];
+        lights.clear();
+        bool fits = for_each_number(line.substr(lp + 1, rp - lp - 1), [&](int idx) {
+            if (idx < nLights) {
+                lights.push_back(idx);
+            }
+        });
+        if (!fits) return false;
+
+        // A light listed twice is still toggled once
+        std::sort(lights.begin(), lights.end());
+        lights.erase(std::unique(lights.begin(), lights.end()), lights.end());
+        pos = rp + 1;
+    }
+    m.buttons.resize(count);
+
+    // Step 3 Joltage requirements inside { ... }
+    m.joltage.clear();
+    if (bracePos != std::string_view::npos) {
+        std::size_t close = line.find('}', bracePos + 1);
+        std::size_t len = close == std::string_view::npos ? std::string_view::npos
+                                                          : close - bracePos - 1;
+        if (!for_each_number(line.substr(bracePos + 1, len),
+                             [&](int value) { m.joltage.push_back(value); })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Open-addressing map from a light state to a small count, for the searches
+// that only visit a sliver of the 2^lights states. Clearing is an epoch
+// bump and the slots only ever grow, so one table serves every machine a
+// worker solves.
+class StateTable {
+public:
+    // Empties the table, sized for about `expected` entries.
+    void reset(std::size_t expected) {
+        std::size_t capacity = 16;
+        while (capacity < 2 * expected) capacity <<= 1;
+        if (keys_.size() < capacity) {
+            keys_.assign(capacity, 0);
+            values_.assign(capacity, 0);
+            stamps_.assign(capacity, 0);
+            epoch_ = 0;
+        }
+        if (++epoch_ == 0) {
+            std::fill(stamps_.begin(), stamps_.end(), 0);
+            epoch_ = 1;
+        }
+        size_ = 0;
+    }
+
+    std::size_t size() const { return size_; }
+
+    // Count stored for key, or -1 if absent.
+    int find(u64 key) const {
+        for (std::size_t i = slot(key);; i = (i + 1) & (keys_.size() - 1)) {
+            if (stamps_[i] != epoch_) return -1;
+            if (keys_[i] == key) return values_[i];
+        }
+    }
+
+    // Stores key -> value if key is new; returns whether it was.
+    bool insert(u64 key, int value) {
+        std::size_t i = locate(key);
+        if (stamps_[i] == epoch_) return false;
+        claim(i, key, value);
+        return true;
+    }
+
+    // Stores key -> value, keeping the smaller count if key is present.
+    void insert_min(u64 key, int value) {
+        std::size_t i = locate(key);
+        if (stamps_[i] == epoch_) {
+            values_[i] = std::min(values_[i], value);
+        } else {
+            claim(i, key, value);
+        }
+    }
+
+private:
+    std::size_t slot(u64 key) const {
+        // splitmix64 finaliser: light states are far from uniform
+        key ^= key >> 30;
+        key *= 0xbf58476d1ce4e5b9ULL;
+        key ^= key >> 27;
+        key *= 0x94d049bb133111ebULL;
+        key ^= key >> 31;
+        return static_cast<std::size_t>(key) & (keys_.size() - 1);
+    }
+
+    std::size_t locate(u64 key) const {
+        std::size_t i = slot(key);
+        while (stamps_[i] == epoch_ && keys_[i] != key) {
+            i = (i + 1) & (keys_.size() - 1);
+        }
+        return i;
+    }
+
+    void claim(std::size_t i, u64 key, int value) {
+        keys_[i] = key;
+        values_[i] = value;
+        stamps_[i] = epoch_;
+        if (2 * ++size_ > keys_.size()) grow();
+    }
+
+    // Doubles the slots and reinserts the live entries.
+    void grow() {
+        std::vector<std::pair<u64, int>> live;
+        live.reserve(size_);
+        for (std::size_t i = 0; i < keys_.size(); ++i) {
+            if (stamps_[i] == epoch_) live.emplace_back(keys_[i], values_[i]);
+        }
+        const std::size_t capacity = 2 * keys_.size();
+        keys_.assign(capacity, 0);
+        values_.assign(capacity, 0);
+        stamps_.assign(capacity, 0);
+        epoch_ = 1;
+        size_ = 0;
+        for (const auto& [key, value] : live) {
+            std::size_t i = locate(key);
+            keys_[i] = key;
+            values_[i] = value;
+            stamps_[i] = epoch_;
+            ++size_;
+        }
+    }
+
+    std::vector<u64> keys_;
+    std::vector<int> values_;
+    std::vector<std::uint32_t> stamps_;
+    std::uint32_t epoch_ = 0;
+    std::size_t size_ = 0;
+};
+
+// Per-worker scratch space for the solvers. Every buffer only ever grows,
+// to the largest machine the worker has met, and is reused for the next
+// one, so solving a machine does not touch the heap.
+struct Scratch {
+    Machine machine;
+
+    // BFS: a state counts as seen when its stamp equals the current epoch,
+    // which saves clearing dist between machines; ring is the FIFO
+    std::vector<std::uint32_t> stamp;
+    std::uint32_t epoch = 0;
+    std::vector<int> dist;
+    std::vector<u64> ring;
+    std::vector<u64> button_masks;
+
+    // Bidirectional BFS and meet in the middle: hashed visited sets and
+    // the layers being expanded
+    StateTable forward, backward;
+    std::vector<u64> frontier[2];
+    std::vector<u64> next_frontier;
+
+    // GF(2) elimination
+    std::vector<u64> rows;
+    std::vector<std::uint8_t> rhs;
+    std::vector<int> pivot_col;
+    std::vector<u64> basis;
+
+    // Integer elimination and branch-and-bound for the joltage
+    std::vector<long long> matrix;
+    std::vector<long long> ub, cost, slack, fall, row_rhs, left;
+    std::vector<int> live, free_cols;
+    std::vector<char> is_pivot;
+};
+
+// Largest machine the BFS cross-check will allocate a state table for.
+constexpr int kMaxBfsLights = 26;
+
+// Fewest presses by BFS over all 2^lights light states; -1 if the target is
+// unreachable. Exponential in the number of lights, kept as a cross-check.
+int min_presses_bfs(const Machine& m, Scratch& s) {
+    const int nLights = static_cast<int>(m.target.size());
+    u64 targetMask = 0;
+    for (int i = 0; i < nLights; ++i) {
+        if (m.target[i]) targetMask |= u64{1} << i;
+    }
+    s.button_masks.clear();
+    for (const auto& b : m.buttons) {
+        u64 mask = 0;
+        for (int idx : b) {
+            mask ^= u64{1} << idx;
         }
+        s.button_masks.push_back(mask);
+    }
+
+    // Tables are powers of two, so the ring index wraps with a mask; every
+    // state enters the queue at most once, so it can never overrun
+    const std::size_t states = std::size_t{1} << nLights;
+    if (s.dist.size() < states) {
+        s.dist.resize(states);
+        s.stamp.assign(states, 0);
+        s.ring.resize(states);
+        s.epoch = 0;
+    }
+    if (++s.epoch == 0) {
+        std::fill(s.stamp.begin(), s.stamp.end(), 0);
+        s.epoch = 1;
+    }
+    const std::size_t wrap = s.ring.size() - 1;
+    std::size_t head = 0;
+    std::size_t tail = 0;
+
+    s.stamp[0] = s.epoch;
+    s.dist[0] = 0;
+    s.ring[tail++ & wrap] = 0;
+
+    while (head != tail && s.stamp[targetMask] != s.epoch) {
+        u64 state = s.ring[head++ & wrap];
+        int d = s.dist[state];
 
-        // Build target mask: bit i corresponds to light i (0-based from the left)
-        // '#' -> 1, '.' -> 0
-        int targetMask = 0;
-        for (int i = 0; i < nLights; ++i) {
-            if (pattern[i] == '#') {
-                targetMask |= (1 << i);
+        // Try pressing each button once
+        for (u64 bm : s.button_masks) {
+            u64 ns = state ^ bm; // toggle bits
+            if (s.stamp[ns] != s.epoch) {
+                s.stamp[ns] = s.epoch;
+                s.dist[ns] = d + 1;
+                s.ring[tail++ & wrap] = ns;
             }
         }
+    }
+    return s.stamp[targetMask] == s.epoch ? s.dist[targetMask] : -1;
+}
 
-        // If target is all off, no presses needed for this machine
-        if (targetMask == 0) {
-            continue;
+// Largest machine the bidirectional search handles: one bit per light.
+constexpr int kMaxBidiLights = 64;
+
+// States either side of the bidirectional search may collect before the
+// machine is reported as too large for it.
+constexpr std::size_t kMaxBidiStates = std::size_t{1} << 22;
+
+// Fewest presses by BFS from both ends at once: from all-off forwards and
+// from the target backwards (a press is its own inverse, so both sides use
+// the same moves). Whichever frontier is smaller grows by one full layer;
+// the first layer that touches a state the other side has seen gives the
+// answer as the smallest sum of the two distances over that layer. Each
+// side only reaches about half the depth, so roughly the square root of the
+// states a one-sided BFS visits. Returns -1 if unreachable, -2 if a side
+// outgrows kMaxBidiStates.
+int min_presses_bidirectional(const Machine& m, Scratch& s) {
+    const int nLights = static_cast<int>(m.target.size());
+    u64 targetMask = 0;
+    for (int i = 0; i < nLights; ++i) {
+        if (m.target[i]) targetMask |= u64{1} << i;
+    }
+    if (targetMask == 0) return 0;
+    s.button_masks.clear();
+    for (const auto& b : m.buttons) {
+        u64 mask = 0;
+        for (int idx : b) {
+            mask ^= u64{1} << idx;
+        }
+        s.button_masks.push_back(mask);
+    }
+
+    // Reachable states are the XOR span of the buttons; checking the target
+    // against a reduced basis spares both sides exhausting it when it is not
+    u64 basis[64] = {};
+    for (u64 v : s.button_masks) {
+        for (int bit = 63; v && bit >= 0; --bit) {
+            if (!(v >> bit & 1)) continue;
+            if (!basis[bit]) basis[bit] = v;
+            v ^= basis[bit];
+        }
+    }
+    u64 rest = targetMask;
+    for (int bit = 63; rest && bit >= 0; --bit) {
+        if (rest >> bit & 1) rest ^= basis[bit];
+    }
+    if (rest) return -1;
+
+    StateTable* seen[2] = {&s.forward, &s.backward};
+    std::vector<u64>* frontier[2] = {&s.frontier[0], &s.frontier[1]};
+    int depth[2] = {0, 0};
+    for (int side = 0; side < 2; ++side) {
+        seen[side]->reset(1024);
+        frontier[side]->clear();
+    }
+    seen[0]->insert(0, 0);
+    seen[1]->insert(targetMask, 0);
+    frontier[0]->push_back(0);
+    frontier[1]->push_back(targetMask);
+
+    while (!frontier[0]->empty() && !frontier[1]->empty()) {
+        const int side = frontier[0]->size() <= frontier[1]->size() ? 0 : 1;
+        StateTable& mine = *seen[side];
+        const StateTable& theirs = *seen[1 - side];
+        const int d = ++depth[side];
+        int best = -1;
+        s.next_frontier.clear();
+        for (u64 state : *frontier[side]) {
+            for (u64 bm : s.button_masks) {
+                u64 ns = state ^ bm;
+                int other = theirs.find(ns);
+                if (other >= 0 && (best < 0 || d + other < best)) best = d + other;
+                if (mine.insert(ns, d)) s.next_frontier.push_back(ns);
+            }
+        }
+        if (best >= 0) return best;
+        if (mine.size() > kMaxBidiStates) return -2;
+        frontier[side]->swap(s.next_frontier);
+    }
+    return -1;
+}
+
+// Largest machine the meet-in-the-middle search handles, i.e. two tables
+// of 2^(buttons/2) subsets.
+constexpr int kMaxMeetButtons = 48;
+
+// Fewest presses by meet in the middle over button subsets: pressing a
+// button twice cancels out, so an optimum presses each at most once. All
+// XORs of the first half of the buttons go into a table with the fewest
+// presses giving each; the subsets of the second half are then walked and
+// looked up against target ^ their XOR. Both halves are walked in Gray-code
+// order, one XOR per subset. Returns -1 if unreachable.
+int min_presses_meet_in_middle(const Machine& m, Scratch& s) {
+    const int nLights = static_cast<int>(m.target.size());
+    const int nButtons = static_cast<int>(m.buttons.size());
+    u64 targetMask = 0;
+    for (int i = 0; i < nLights; ++i) {
+        if (m.target[i]) targetMask |= u64{1} << i;
+    }
+    s.button_masks.clear();
+    for (const auto& b : m.buttons) {
+        u64 mask = 0;
+        for (int idx : b) {
+            mask ^= u64{1} << idx;
+        }
+        s.button_masks.push_back(mask);
+    }
+
+    const int low = nButtons / 2;
+    const int high = nButtons - low;
+    StateTable& table = s.forward;
+    table.reset(std::size_t{1} << low);
+    u64 x = 0;
+    table.insert_min(0, 0);
+    for (u64 i = 1; i < (u64{1} << low); ++i) {
+        x ^= s.button_masks[std::countr_zero(i)];
+        table.insert_min(x, std::popcount(i ^ (i >> 1)));
+    }
+
+    int best = table.find(targetMask);
+    x = 0;
+    for (u64 i = 1; i < (u64{1} << high); ++i) {
+        x ^= s.button_masks[low + std::countr_zero(i)];
+        int first = table.find(targetMask ^ x);
+        if (first < 0) continue;
+        int total = first + std::popcount(i ^ (i >> 1));
+        if (best < 0 || total < best) best = total;
+    }
+    return best;
+}
+
+// Largest machine the GF(2) solver handles: one bit per button in a row.
+constexpr int kMaxButtons = 64;
+
+// Free variables up to which the null space is walked in Gray-code order.
+constexpr int kGrayCodeLimit = 24;
+
+// Fewest presses as a minimum-weight solution of A x = t over GF(2), where
+// A[light][button] says whether the button toggles the light (pressing a
+// button twice cancels out). Gauss-Jordan elimination on one u64 row per
+// light gives a particular solution x0 and one null-space vector per free
+// button; every solution is x0 plus a subset of those. Up to
+// kGrayCodeLimit free buttons all subsets are walked in Gray-code order,
+// one XOR and popcount each; beyond that, subsets are tried by increasing
+// size, which stops once the size alone reaches the best weight because
+// each null-space vector owns its free button. Returns -1 if unsolvable.
+int min_presses_gf2(const Machine& m, Scratch& s) {
+    const int nLights = static_cast<int>(m.target.size());
+    const int nButtons = static_cast<int>(m.buttons.size());
+
+    std::vector<u64>& rows = s.rows;
+    std::vector<std::uint8_t>& rhs = s.rhs;
+    rows.assign(nLights, 0);
+    rhs.assign(m.target.begin(), m.target.end());
+    for (int j = 0; j < nButtons; ++j) {
+        for (int idx : m.buttons[j]) {
+            rows[idx] ^= u64{1} << j;
+        }
+    }
+
+    std::vector<int>& pivot_col = s.pivot_col;
+    pivot_col.clear();
+    u64 pivots = 0;
+    int rank = 0;
+    for (int col = 0; col < nButtons && rank < nLights; ++col) {
+        const u64 bit = u64{1} << col;
+        int r = rank;
+        while (r < nLights && !(rows[r] & bit)) ++r;
+        if (r == nLights) continue; // free button
+        std::swap(rows[r], rows[rank]);
+        std::swap(rhs[r], rhs[rank]);
+        for (int rr = 0; rr < nLights; ++rr) {
+            if (rr != rank && (rows[rr] & bit)) {
+                rows[rr] ^= rows[rank];
+                rhs[rr] ^= rhs[rank];
+            }
         }
+        pivot_col.push_back(col);
+        pivots |= bit;
+        ++rank;
+    }
+    for (int r = rank; r < nLights; ++r) {
+        if (rhs[r]) return -1; // 0 = 1: inconsistent
+    }
+
+    u64 x0 = 0;
+    for (int r = 0; r < rank; ++r) {
+        if (rhs[r]) x0 |= u64{1} << pivot_col[r];
+    }
+    std::vector<u64>& basis = s.basis;
+    basis.clear();
+    for (int f = 0; f < nButtons; ++f) {
+        const u64 bit = u64{1} << f;
+        if (pivots & bit) continue;
+        u64 v = bit;
+        for (int r = 0; r < rank; ++r) {
+            if (rows[r] & bit) v |= u64{1} << pivot_col[r];
+        }
+        basis.push_back(v);
+    }
 
-        // Step 2 Extract button masks from ( ... ) BEFORE the { ... } block
-        std::vector<int> buttonMasks;
+    const int k = static_cast<int>(basis.size());
+    int best = std::popcount(x0);
+    if (k <= kGrayCodeLimit) {
+        u64 x = x0;
+        for (u64 i = 1; i < (u64{1} << k); ++i) {
+            x ^= basis[std::countr_zero(i)];
+            best = std::min(best, std::popcount(x));
+        }
+        return best;
+    }
 
-        // Only parse up to '{' (ignore joltage block)
-        std::size_t bracePos = line.find('{', rb + 1);
-        std::size_t searchEnd = (bracePos == std::string::npos) ? line.size() : bracePos;
+    // best > 0 here implies rank > 0, so k < 64 and the shifts are safe
+    for (int w = 1; w < best && w <= k; ++w) {
+        // Gosper's hack over the w-subsets of the k free buttons
+        for (u64 sub = (u64{1} << w) - 1; sub < (u64{1} << k);) {
+            u64 x = x0;
+            for (u64 t = sub; t; t &= t - 1) {
+                x ^= basis[std::countr_zero(t)];
+            }
+            best = std::min(best, std::popcount(x));
+            u64 c = sub & -sub;
+            u64 r = sub + c;
+            sub = (((r ^ sub) >> 2) / c) | r;
+        }
+    }
+    return best;
+}
 
-        std::size_t pos = rb + 1;
-        while (true) {
-            std::size_t lp = line.find('(', pos);
-            if (lp == std::string::npos || lp >= searchEnd) break;
-            std::size_t rp = line.find(')', lp + 1);
-            if (rp == std::string::npos || rp > searchEnd) break;
+// Largest machine the parity-split recursion enumerates button subsets for.
+constexpr int kMaxParityButtons = 20;
 
-            std::string inside = line.substr(lp + 1, rp - lp - 1);
+// Alternative Part 2 strategy. Any solution splits as x = s + 2y with s the
+// set of buttons pressed an odd number of times; s must match the parity of
+// every target and not overshoot it, and y then solves (t - A s) / 2. So
+// f(t) = min over such s of |s| + 2 f((t - A s) / 2), f(0) = 0, memoised on
+// t. Subsets are precomputed once and grouped by their parity pattern.
+// Returns -1 if no assignment works.
+long long min_presses_joltage_parity(const Machine& m) {
+    using ll = long long;
+    const int n = static_cast<int>(m.joltage.size());
+    const int nb = static_cast<int>(m.buttons.size());
 
-            // Replace commas with spaces to simplify parsing "0,1,2" etc.
-            for (char &ch : inside) {
-                if (ch == ',') ch = ' ';
+    struct Subset {
+        std::vector<int> effect;
+        int size;
+    };
+    std::unordered_map<u64, std::vector<Subset>> by_parity;
+    for (u64 s = 0; s < (u64{1} << nb); ++s) {
+        Subset sub{std::vector<int>(n, 0), std::popcount(s)};
+        u64 parity = 0;
+        for (int j = 0; j < nb; ++j) {
+            if (!(s >> j & 1)) continue;
+            for (int idx : m.buttons[j]) {
+                if (idx < n) sub.effect[idx] += 1;
             }
+        }
+        for (int i = 0; i < n; ++i) {
+            if (sub.effect[i] & 1) parity |= u64{1} << i;
+        }
+        by_parity[parity].push_back(std::move(sub));
+    }
+
+    struct VecHash {
+        std::size_t operator()(const std::vector<int>& v) const {
+            std::size_t h = 0;
+            for (int x : v) h = h * 1000003u ^ static_cast<std::size_t>(x);
+            return h;
+        }
+    };
+    std::unordered_map<std::vector<int>, ll, VecHash> memo;
+    constexpr ll kImpossible = std::numeric_limits<ll>::max() / 4;
+
+    auto solve = [&](auto&& self, const std::vector<int>& t) -> ll {
+        if (std::all_of(t.begin(), t.end(), [](int v) { return v == 0; })) return 0;
+        auto it = memo.find(t);
+        if (it != memo.end()) return it->second;
 
-            std::stringstream ss(inside);
-            int mask = 0;
-            int idx;
-            while (ss >> idx) {
-                if (idx >= 0 && idx < nLights) {
-                    mask |= (1 << idx);
+        u64 parity = 0;
+        for (int i = 0; i < n; ++i) {
+            if (t[i] & 1) parity |= u64{1} << i;
+        }
+        ll best = kImpossible;
+        auto group = by_parity.find(parity);
+        if (group != by_parity.end()) {
+            std::vector<int> half(n);
+            for (const Subset& sub : group->second) {
+                bool fits = true;
+                for (int i = 0; i < n && fits; ++i) {
+                    if (sub.effect[i] > t[i]) fits = false;
+                    half[i] = (t[i] - sub.effect[i]) / 2;
                 }
+                if (!fits || sub.size >= best) continue;
+                ll rest = self(self, half);
+                if (rest < kImpossible) best = std::min(best, sub.size + 2 * rest);
             }
+        }
+        memo.emplace(t, best);
+        return best;
+    };
+    ll best = solve(solve, m.joltage);
+    return best < kImpossible ? best : -1;
+}
+
+// Free buttons beyond which the branch-and-bound hands over to the
+// parity-split recursion.
+constexpr int kMaxSearchFree = 5;
+
+// Fewest presses so that counter i receives exactly joltage[i] increments,
+// where pressing button j x_j >= 0 times adds x_j to each counter it is
+// wired to: minimise sum(x) subject to A x = t over the non-negative
+// integers. Fraction-free Gauss-Jordan elimination expresses each pivot
+// button through the free ones as p_r x_pivot = b_r - sum_f a_rf x_f, so
+// only the free buttons (few in practice) are searched, each bounded by
+// the smallest target it feeds. Branch-and-bound prunes a partial
+// assignment when some pivot row can no longer stay non-negative, or when
+// the objective, linear in the free buttons, cannot drop below the best
+// found. Machines with many free buttons go to the parity-split recursion
+// instead when it applies. Returns -1 if no assignment works.
+long long min_presses_joltage(const Machine& m, Scratch& s) {
+    using ll = long long;
+    const int n = static_cast<int>(m.joltage.size());
 
-            buttonMasks.push_back(mask);
-            pos = rp + 1;
+    // A button feeding a counter that must stay at 0 can never be pressed,
+    // and one wired to no counter is useless; only the rest become columns
+    std::vector<int>& live = s.live;
+    live.clear();
+    for (int j = 0; j < static_cast<int>(m.buttons.size()); ++j) {
+        bool wired = false;
+        bool blocked = false;
+        for (int idx : m.buttons[j]) {
+            if (idx >= n) continue;
+            wired = true;
+            blocked |= m.joltage[idx] == 0;
         }
+        if (wired && !blocked) live.push_back(j);
+    }
+    const int nb = static_cast<int>(live.size());
+    const int width = nb + 1;
 
-        if (buttonMasks.empty()) {
-            // No buttons to press, but target is not zero => impossible, skip or handle as you like
-            continue;
+    // Augmented matrix, one row of width per counter, b in the last column
+    std::vector<ll>& M = s.matrix;
+    std::vector<ll>& ub = s.ub;
+    M.assign(static_cast<std::size_t>(n) * width, 0);
+    ub.assign(nb, std::numeric_limits<ll>::max());
+    auto at = [&](int r, int c) -> ll& { return M[static_cast<std::size_t>(r) * width + c]; };
+    for (int j = 0; j < nb; ++j) {
+        for (int idx : m.buttons[live[j]]) {
+            if (idx >= n) continue;
+            at(idx, j) = 1;
+            ub[j] = std::min<ll>(ub[j], m.joltage[idx]);
         }
+    }
+    for (int i = 0; i < n; ++i) {
+        at(i, nb) = m.joltage[i];
+    }
 
-        // Step 3 BFS over state space [0 .. (1<<nLights)-1]
-        int maxState = 1 << nLights;
-        std::vector<int> dist(maxState, -1);
-        std::queue<int> q;
+    auto normalise = [&](int r) {
+        ll g = 0;
+        for (int k = 0; k <= nb; ++k) g = std::gcd(g, at(r, k));
+        if (g > 1) {
+            for (int k = 0; k <= nb; ++k) at(r, k) /= g;
+        }
+    };
 
-        dist[0] = 0;
-        q.push(0);
+    std::vector<int>& pivot_col = s.pivot_col;
+    pivot_col.clear();
+    int rank = 0;
+    for (int col = 0; col < nb && rank < n; ++col) {
+        int r = rank;
+        while (r < n && at(r, col) == 0) ++r;
+        if (r == n) continue;
+        if (r != rank) {
+            std::swap_ranges(&at(r, 0), &at(r, 0) + width, &at(rank, 0));
+        }
+        for (int rr = 0; rr < n; ++rr) {
+            if (rr == rank || at(rr, col) == 0) continue;
+            ll a = at(rank, col);
+            ll c = at(rr, col);
+            ll g = std::gcd(a, c);
+            for (int k = 0; k <= nb; ++k) {
+                at(rr, k) = at(rr, k) * (a / g) - at(rank, k) * (c / g);
+            }
+            normalise(rr);
+        }
+        normalise(rank);
+        pivot_col.push_back(col);
+        ++rank;
+    }
+    // Later steps scale earlier rows by signed factors, so fix signs last
+    for (int r = 0; r < rank; ++r) {
+        if (at(r, pivot_col[r]) < 0) {
+            for (int k = 0; k <= nb; ++k) at(r, k) = -at(r, k);
+        }
+    }
+    for (int r = rank; r < n; ++r) {
+        if (at(r, nb) != 0) return -1; // 0 = b: inconsistent
+    }
 
-        while (!q.empty() && dist[targetMask] == -1) {
-            int s = q.front();
-            q.pop();
-            int d = dist[s];
+    std::vector<int>& free_cols = s.free_cols;
+    free_cols.clear();
+    s.is_pivot.assign(nb, 0);
+    for (int c : pivot_col) s.is_pivot[c] = 1;
+    for (int c = 0; c < nb; ++c) {
+        if (!s.is_pivot[c]) free_cols.push_back(c);
+    }
+    // Tightly bounded buttons first keep the upper levels of the tree narrow
+    std::stable_sort(free_cols.begin(), free_cols.end(),
+                     [&](int a, int b) { return ub[a] < ub[b]; });
+    const int F = static_cast<int>(free_cols.size());
+    if (F > kMaxSearchFree && static_cast<int>(m.buttons.size()) <= kMaxParityButtons &&
+        n <= 64) {
+        // Too many free buttons for the search to stay cheap; the subset
+        // recursion's cost depends on the button count alone
+        return min_presses_joltage_parity(m);
+    }
 
-            // Try pressing each button once
-            for (int bm : buttonMasks) {
-                int ns = s ^ bm; // toggle bits
-                if (dist[ns] == -1) {
-                    dist[ns] = d + 1;
-                    q.push(ns);
-                }
+    // Objective scaled by D = lcm(p_r): D * sum(x) = K0 + sum_f C_f x_f.
+    // If D would overflow, the objective bound is simply not used.
+    ll D = 1;
+    bool use_bound = true;
+    for (int r = 0; r < rank && use_bound; ++r) {
+        ll p = at(r, pivot_col[r]);
+        ll step = p / std::gcd(D, p);
+        if (__builtin_mul_overflow(D, step, &D) || D > (ll{1} << 40)) use_bound = false;
+    }
+    ll K0 = 0;
+    std::vector<ll>& C = s.cost;
+    C.assign(F, 0);
+    if (use_bound) {
+        for (int r = 0; r < rank; ++r) {
+            K0 += D / at(r, pivot_col[r]) * at(r, nb);
+        }
+        for (int k = 0; k < F; ++k) {
+            C[k] = D;
+            for (int r = 0; r < rank; ++r) {
+                C[k] -= D / at(r, pivot_col[r]) * at(r, free_cols[k]);
             }
         }
+    }
 
-        if (dist[targetMask] == -1) {
-            // No way to reach target with any combination of button presses.
-            // The puzzle likely guarantees this won't happen.
-            // We'll just skip adding anything.
-            continue;
+    // Suffix bounds over free buttons k.. : the most a row's right-hand side
+    // can still grow (slack, rank entries per k), and the most the objective
+    // can still fall
+    std::vector<ll>& slack = s.slack;
+    std::vector<ll>& fall = s.fall;
+    slack.assign(static_cast<std::size_t>(F + 1) * rank, 0);
+    fall.assign(F + 1, 0);
+    for (int k = F - 1; k >= 0; --k) {
+        for (int r = 0; r < rank; ++r) {
+            ll a = at(r, free_cols[k]);
+            slack[k * rank + r] = slack[(k + 1) * rank + r] + (a < 0 ? -a * ub[free_cols[k]] : 0);
+        }
+        fall[k] = fall[k + 1] + std::min<ll>(0, C[k] * ub[free_cols[k]]);
+    }
+
+    std::vector<ll>& rhs = s.row_rhs;
+    rhs.resize(rank);
+    for (int r = 0; r < rank; ++r) {
+        rhs[r] = at(r, nb);
+    }
+    // Counters still to fill once the chosen free buttons are pressed; a
+    // free button can never be pressed more often than what is left
+    std::vector<ll>& left = s.left;
+    left.assign(m.joltage.begin(), m.joltage.end());
+    ll best = -1;
+    ll free_sum = 0;
+
+    auto dfs = [&](auto&& self, int k, ll partial) -> void {
+        if (k == F) {
+            ll total = free_sum;
+            for (int r = 0; r < rank; ++r) {
+                ll p = at(r, pivot_col[r]);
+                if (rhs[r] < 0 || rhs[r] % p != 0) return;
+                total += rhs[r] / p;
+            }
+            if (best < 0 || total < best) best = total;
+            return;
         }
+        const int col = free_cols[k];
+        ll lo = 0;
+        ll hi = ub[col];
+        for (int idx : m.buttons[live[col]]) {
+            if (idx < n) hi = std::min(hi, left[idx]);
+        }
+        // Each row must stay within reach of non-negative with the slack the
+        // later free buttons can still add, which bounds x from both sides
+        for (int r = 0; r < rank && lo <= hi; ++r) {
+            ll a = at(r, col);
+            ll room = rhs[r] + slack[(k + 1) * rank + r];
+            if (a > 0) {
+                hi = std::min(hi, room >= 0 ? room / a : -1);
+            } else if (a < 0 && room < 0) {
+                lo = std::max(lo, (-room + (-a) - 1) / -a);
+            }
+        }
+        // Walk towards the cheaper end first so good bounds come early; the
+        // objective only gets worse from there, so the first cut-off ends it
+        const bool down = C[k] < 0;
+        for (ll step = 0; step <= hi - lo; ++step) {
+            ll x = down ? hi - step : lo + step;
+            ll obj = partial + C[k] * x;
+            if (use_bound && best >= 0 && K0 + obj + fall[k + 1] >= best * D) break;
+            for (int r = 0; r < rank; ++r) {
+                rhs[r] -= at(r, col) * x;
+            }
+            for (int idx : m.buttons[live[col]]) {
+                if (idx < n) left[idx] -= x;
+            }
+            free_sum += x;
+            self(self, k + 1, obj);
+            free_sum -= x;
+            for (int idx : m.buttons[live[col]]) {
+                if (idx < n) left[idx] += x;
+            }
+            for (int r = 0; r < rank; ++r) {
+                rhs[r] += at(r, col) * x;
+            }
+        }
+    };
+    dfs(dfs, 0, 0);
+    return best;
+}
+
+// How Part 1 is solved: GF(2) elimination by default, the searches as
+// cross-checks.
+enum class LightSolver { Gf2, Bfs, Bidirectional, MeetInMiddle };
+
+// Part 1 presses for one machine, 0 when it is skipped (with the reason in
+// error when it is worth reporting).
+long long light_presses(const Machine& machine, LightSolver solver, Scratch& scratch,
+                        std::string& error) {
+    // If target is all off (or there are no lights), no presses needed
+    if (std::find(machine.target.begin(), machine.target.end(), 1) == machine.target.end()) {
+        return 0;
+    }
+
+    if (machine.buttons.empty()) {
+        // No buttons to press, but target is not zero => impossible, skip
+        return 0;
+    }
+
+    const int nLights = static_cast<int>(machine.target.size());
+    const int nButtons = static_cast<int>(machine.buttons.size());
+    int presses = -1;
+    switch (solver) {
+    case LightSolver::Bfs:
+        if (nLights > kMaxBfsLights) {
+            error = "too many lights for --bfs";
+            return 0;
+        }
+        presses = min_presses_bfs(machine, scratch);
+        break;
+    case LightSolver::Bidirectional:
+        if (nLights > kMaxBidiLights) {
+            error = "too many lights for --bidi";
+            return 0;
+        }
+        presses = min_presses_bidirectional(machine, scratch);
+        if (presses == -2) {
+            error = "state space too large for --bidi";
+            return 0;
+        }
+        break;
+    case LightSolver::MeetInMiddle:
+        if (nLights > 64 || nButtons > kMaxMeetButtons) {
+            error = "machine too large for --mitm";
+            return 0;
+        }
+        presses = min_presses_meet_in_middle(machine, scratch);
+        break;
+    case LightSolver::Gf2:
+        if (nButtons > kMaxButtons) {
+            error = "more than " + std::to_string(kMaxButtons) + " buttons";
+            return 0;
+        }
+        presses = min_presses_gf2(machine, scratch);
+        break;
+    }
+
+    if (presses == -1) {
+        // No way to reach target with any combination of button presses.
+        // The puzzle likely guarantees this won't happen.
+        // We'll just skip adding anything.
+        return 0;
+    }
+    return presses;
+}
+
+// Part 2 presses for one machine, 0 when it is skipped (with the reason in
+// error).
+long long joltage_presses(const Machine& machine, bool use_parity, Scratch& scratch,
+                          std::string& error) {
+    long long presses = -1;
+    if (use_parity) {
+        if (static_cast<int>(machine.buttons.size()) > kMaxParityButtons ||
+            machine.joltage.size() > 64) {
+            error = "machine too large for --parity";
+            return 0;
+        }
+        presses = min_presses_joltage_parity(machine);
+    } else {
+        presses = min_presses_joltage(machine, scratch);
+    }
+    if (presses == -1) {
+        error = "joltage targets unreachable";
+        return 0;
+    }
+    return presses;
+}
+
+// Runs fn(worker) on `threads` threads, the calling thread being worker 0.
+template <class Fn>
+void parallel_for(unsigned threads, Fn fn) {
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(fn, t);
+    }
+    fn(0);
+    for (auto& th : pool) {
+        th.join();
+    }
+}
 
-        total_presses += dist[targetMask];
+int main(int argc, char* argv[]) {
+    // --bfs, --bidi and --mitm cross-check Part 1 with the exhaustive,
+    // bidirectional and meet-in-the-middle searches, --parity Part 2 with
+    // the parity-split recursion. --profile: per-phase hardware counters on
+    // stderr
+    LightSolver solver = LightSolver::Gf2;
+    bool use_parity = false;
+    bool profile = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--bfs") == 0) solver = LightSolver::Bfs;
+        if (std::strcmp(argv[i], "--bidi") == 0) solver = LightSolver::Bidirectional;
+        if (std::strcmp(argv[i], "--mitm") == 0) solver = LightSolver::MeetInMiddle;
+        if (std::strcmp(argv[i], "--parity") == 0) use_parity = true;
+        if (std::strcmp(argv[i], "--profile") == 0) profile = true;
+    }
+
+    PhaseProfiler profiler(profile);
+
+    profiler.phase("read");
+    std::ifstream in("input.txt", std::ios::binary);
+    if (!in) {
+        std::cerr << "Error: could not open input.txt\n";
+        return 1;
+    }
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    // Every line is an independent machine
+    std::vector<std::string_view> lines;
+    for (std::size_t pos = 0; pos < text.size();) {
+        std::size_t end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string_view line(text.data() + pos, end - pos);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        // Skip empty lines
+        if (!line.empty()) lines.push_back(line);
+        pos = end + 1;
+    }
+
+    // Machines are handed out in small chunks, since their cost varies a
+    // lot; each worker solves them in its own Scratch and keeps its own
+    // sums, reduced once everyone is done
+    profiler.phase("solve");
+    struct Partial {
+        long long presses = 0;
+        long long joltage = 0;
+        std::vector<std::pair<std::size_t, std::string>> errors; // line, reason
+    };
+    constexpr std::size_t kChunk = 64;
+    const std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    const auto threads =
+        static_cast<unsigned>(std::clamp<std::size_t>(lines.size() / kChunk, 1, cores));
+    std::vector<Partial> partial(threads);
+    std::atomic<std::size_t> next{0};
+
+    parallel_for(threads, [&](unsigned w) {
+        Scratch scratch;
+        Partial& out = partial[w];
+        std::string error;
+        for (std::size_t begin = next.fetch_add(kChunk); begin < lines.size();
+             begin = next.fetch_add(kChunk)) {
+            std::size_t end = std::min(lines.size(), begin + kChunk);
+            for (std::size_t i = begin; i < end; ++i) {
+                Machine& machine = scratch.machine;
+                if (!parse_machine(lines[i], machine)) {
+                    // malformed line, skip
+                    continue;
+                }
+                out.presses += light_presses(machine, solver, scratch, error);
+                if (!error.empty()) out.errors.emplace_back(i, std::move(error));
+                error.clear();
+                out.joltage += joltage_presses(machine, use_parity, scratch, error);
+                if (!error.empty()) out.errors.emplace_back(i, std::move(error));
+                error.clear();
+            }
+        }
+    });
+
+    long long total_presses = 0;  // Part 1, sum over all machines
+    long long total_joltage = 0;  // Part 2, sum over all machines
+    std::vector<std::pair<std::size_t, std::string>> errors;
+    for (Partial& p : partial) {
+        total_presses += p.presses;
+        total_joltage += p.joltage;
+        std::move(p.errors.begin(), p.errors.end(), std::back_inserter(errors));
+    }
+    std::stable_sort(errors.begin(), errors.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (const auto& [i, reason] : errors) {
+        std::cerr << "Error: " << reason << ", skipping: " << lines[i] << '\n';
     }
 
-    std::cout << total_presses << '\n';
+    std::cout << "Part 1 (fewest presses for lights):  " << total_presses << '\n';
+    std::cout << "Part 2 (fewest presses for joltage): " << total_joltage << '\n';
+    profiler.report();
     return 0;
-}
\ No newline at end of file
+}
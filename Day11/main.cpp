@@ -1,205 +1,1097 @@
 #include <fstream>
 #include <iostream>
 #include <string>
-#include <sstream>
+#include <string_view>
+#include <iterator>
 #include <vector>
 #include <unordered_map>
-#include <functional>
+#include <utility>
+#include <list>
+#include <cstdlib>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <cctype>
+#include <array>
+#include <type_traits>
 
-int main() {
-    std::ios::sync_with_stdio(false);
-    std::cin.tie(nullptr);
+#include "profile.h"
 
-    std::ifstream in("input.txt");
-    if (!in) {
-        std::cerr << "Error: could not open input.txt\n";
-        return 1;
+// Interns device names as dense indices, numbered in order of first
+// appearance. Names of exactly three lowercase letters, which is every
+// name in the puzzle input, index a 26^3 table directly, so the common case
+// never hashes. Other lowercase names of up to 13 letters pack into a u64
+// (base 27, so lengths stay distinct) for an integer-keyed map, and only
+// the rest are hashed as strings.
+class NameTable {
+public:
+    NameTable() : short_(26 * 26 * 26, -1) {}
+
+    int size() const { return count_; }
+
+    // Index of name, assigning the next free one if it is new.
+    int intern(std::string_view name) {
+        int key = short_key(name);
+        if (key >= 0) {
+            if (short_[key] == -1) {
+                short_[key] = count_++;
+                names_.emplace_back(name);
+            }
+            return short_[key];
+        }
+        if (std::uint64_t packed = packed_key(name)) {
+            auto [it, inserted] = packed_.try_emplace(packed, count_);
+            if (inserted) {
+                ++count_;
+                names_.emplace_back(name);
+            }
+            return it->second;
+        }
+        auto [it, inserted] = long_.try_emplace(std::string(name), count_);
+        if (inserted) {
+            ++count_;
+            names_.emplace_back(name);
+        }
+        return it->second;
     }
 
-    // First pass: parse lines into raw adjacency with names
-    std::vector<std::pair<std::string, std::vector<std::string>>> raw;
-    std::string line;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
+    const std::string& name(int index) const { return names_[index]; }
 
-        // Find device name before ':'
-        std::size_t colonPos = line.find(':');
-        if (colonPos == std::string::npos) continue;
+    // Index of name, or -1 if it never appeared.
+    int find(std::string_view name) const {
+        int key = short_key(name);
+        if (key >= 0) return short_[key];
+        if (std::uint64_t packed = packed_key(name)) {
+            auto it = packed_.find(packed);
+            return it == packed_.end() ? -1 : it->second;
+        }
+        auto it = long_.find(std::string(name));
+        return it == long_.end() ? -1 : it->second;
+    }
 
-        std::string src = line.substr(0, colonPos);
-        // trim spaces on src
-        auto trim = [](std::string &s) {
-            while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) {
-                s.pop_back();
+private:
+    static int short_key(std::string_view name) {
+        if (name.size() != 3) return -1;
+        int key = 0;
+        for (char c : name) {
+            if (c < 'a' || c > 'z') return -1;
+            key = key * 26 + (c - 'a');
+        }
+        return key;
+    }
+
+    // 0 if name does not pack
+    static std::uint64_t packed_key(std::string_view name) {
+        if (name.empty() || name.size() > 13) return 0;
+        std::uint64_t key = 0;
+        for (char c : name) {
+            if (c < 'a' || c > 'z') return 0;
+            key = key * 27 + static_cast<std::uint64_t>(c - 'a' + 1);
+        }
+        return key;
+    }
+
+    std::vector<int> short_;
+    std::unordered_map<std::uint64_t, int> packed_;
+    std::unordered_map<std::string, int> long_;
+    std::vector<std::string> names_;
+    int count_ = 0;
+};
+
+// Directed graph in compressed sparse row form: the successors of u are
+// targets[offsets[u]] .. targets[offsets[u + 1] - 1].
+struct Csr {
+    std::vector<int> offsets;
+    std::vector<int> targets;
+
+    int size() const { return static_cast<int>(offsets.size()) - 1; }
+    const int* begin(int u) const { return targets.data() + offsets[u]; }
+    const int* end(int u) const { return targets.data() + offsets[u + 1]; }
+};
+
+// Builds the CSR of n nodes from an edge list by counting sort on the
+// source, keeping the input order of each node's edges. With reverse set,
+// every edge is flipped first.
+Csr make_csr(int n, const std::vector<std::pair<int, int>>& edges, bool reverse) {
+    Csr g;
+    g.offsets.assign(n + 1, 0);
+    for (const auto& [u, v] : edges) {
+        ++g.offsets[(reverse ? v : u) + 1];
+    }
+    for (int u = 0; u < n; ++u) {
+        g.offsets[u + 1] += g.offsets[u];
+    }
+    g.targets.resize(edges.size());
+    std::vector<int> fill(g.offsets.begin(), g.offsets.end() - 1);
+    for (const auto& [u, v] : edges) {
+        if (reverse) {
+            g.targets[fill[v]++] = u;
+        } else {
+            g.targets[fill[u]++] = v;
+        }
+    }
+    return g;
+}
+
+// The device graph condensed to its strongly connected components, so it
+// is acyclic: forward and reverse CSR over components plus one topological
+// order, in which every edge goes from a smaller position to a larger one.
+// A component is cyclic when it holds a feedback loop (several devices, or
+// one wired to itself); any route through one can go round it as often as
+// it likes. On an acyclic input every device is its own component.
+struct Graph {
+    Csr out;
+    Csr in;
+    std::vector<int> order;     // components in topological order
+    std::vector<int> position;  // position[order[i]] == i
+    std::vector<int> component; // component of each device
+    std::vector<char> cyclic;   // per component
+    std::vector<std::vector<int>> members; // devices of each cyclic component
+};
+
+// Strongly connected components by Tarjan's algorithm, with an explicit
+// call stack so that deep graphs cannot overflow the native one. Linear in
+// the graph size. Components are numbered in the order they complete, which
+// lists every component after all the ones it has edges into. Returns the
+// number of components.
+int strongly_connected_components(const Csr& g, std::vector<int>& component) {
+    const int n = g.size();
+    std::vector<int> index(n, -1);
+    std::vector<int> low(n);
+    std::vector<char> on_stack(n, 0);
+    std::vector<int> stack;
+    std::vector<std::pair<int, int>> calls; // (device, next edge offset)
+    component.assign(n, -1);
+    int next_index = 0;
+    int count = 0;
+
+    for (int root = 0; root < n; ++root) {
+        if (index[root] != -1) continue;
+        index[root] = low[root] = next_index++;
+        stack.push_back(root);
+        on_stack[root] = 1;
+        calls.emplace_back(root, g.offsets[root]);
+
+        while (!calls.empty()) {
+            const int u = calls.back().first;
+            const int e = calls.back().second;
+            if (e < g.offsets[u + 1]) {
+                ++calls.back().second;
+                int v = g.targets[e];
+                if (index[v] == -1) {
+                    index[v] = low[v] = next_index++;
+                    stack.push_back(v);
+                    on_stack[v] = 1;
+                    calls.emplace_back(v, g.offsets[v]);
+                } else if (on_stack[v]) {
+                    low[u] = std::min(low[u], index[v]);
+                }
+                continue;
             }
-            std::size_t i = 0;
-            while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i]))) {
-                ++i;
+
+            // u is done: hand its low link to the caller, close its component
+            calls.pop_back();
+            if (!calls.empty()) {
+                int parent = calls.back().first;
+                low[parent] = std::min(low[parent], low[u]);
             }
-            if (i > 0) {
-                s.erase(0, i);
+            if (low[u] == index[u]) {
+                int w;
+                do {
+                    w = stack.back();
+                    stack.pop_back();
+                    on_stack[w] = 0;
+                    component[w] = count;
+                } while (w != u);
+                ++count;
             }
-        };
-        trim(src);
+        }
+    }
+    return count;
+}
 
-        std::string rhs = line.substr(colonPos + 1);
-        // split rhs on spaces
-        std::stringstream ss(rhs);
-        std::string token;
-        std::vector<std::string> outs;
-        while (ss >> token) {
-            outs.push_back(token);
+// Builds the condensed graph of n devices from their edges. Components are
+// renumbered so that their numbers are already a topological order, and
+// edges inside a component are dropped (they only decide whether it is
+// cyclic). Parallel edges between components are kept: each is a separate
+// route.
+Graph condense(int n, const std::vector<std::pair<int, int>>& edges) {
+    Graph g;
+    const Csr devices = make_csr(n, edges, false);
+    const int count = strongly_connected_components(devices, g.component);
+    for (int& c : g.component) {
+        c = count - 1 - c;
+    }
+
+    std::vector<int> size(count, 0);
+    for (int v = 0; v < n; ++v) {
+        ++size[g.component[v]];
+    }
+    g.cyclic.assign(count, 0);
+    for (int c = 0; c < count; ++c) {
+        g.cyclic[c] = size[c] > 1;
+    }
+    std::vector<std::pair<int, int>> between;
+    between.reserve(edges.size());
+    for (const auto& [u, v] : edges) {
+        int cu = g.component[u];
+        int cv = g.component[v];
+        if (cu == cv) {
+            g.cyclic[cu] = 1; // a self-loop, or an edge inside a larger component
+        } else {
+            between.emplace_back(cu, cv);
         }
+    }
+    g.members.resize(count);
+    for (int v = 0; v < n; ++v) {
+        if (g.cyclic[g.component[v]]) g.members[g.component[v]].push_back(v);
+    }
 
-        raw.push_back({src, outs});
+    g.out = make_csr(count, between, false);
+    g.in = make_csr(count, between, true);
+    g.order.resize(count);
+    g.position.resize(count);
+    for (int c = 0; c < count; ++c) {
+        g.order[c] = g.position[c] = c;
     }
+    return g;
+}
 
-    // Map device name -> index
-    std::unordered_map<std::string, int> id;
-    id.reserve(raw.size() * 2);
+// Path counts grow exponentially with the depth of a layered graph, so the
+// counting code is templated over the count type. Each type has zero(),
+// one() and infinite() (a route that reaches a feedback loop can circle it
+// any number of times), +=, *, is_zero(), is_infinite(), saturated() and
+// str(). Infinity absorbs sums and products, except that a product with 0
+// stays 0.
 
-    auto get_id = [&](const std::string &name) -> int {
-        auto it = id.find(name);
-        if (it != id.end()) return it->second;
-        int newId = static_cast<int>(id.size());
-        id[name] = newId;
-        return newId;
-    };
+// Decimal digits of an unsigned integer of any built-in width.
+template <class U>
+std::string to_decimal(U v) {
+    std::string digits;
+    do {
+        digits.push_back(static_cast<char>('0' + static_cast<int>(v % 10)));
+        v /= 10;
+    } while (v != 0);
+    return std::string(digits.rbegin(), digits.rend());
+}
 
-    // Ensure all nodes have indices
-    for (auto &p : raw) {
-        get_id(p.first);
-        for (auto &to : p.second) {
-            get_id(to);
+// Fixed-width unsigned count that saturates instead of wrapping. The top
+// value is infinity and the one below it "too large": saturated() then
+// tells the caller to retry in a wider type. Both checks are a compare on
+// top of the plain add or multiply.
+template <class U>
+class CheckedCount {
+public:
+    CheckedCount() = default;
+    static CheckedCount zero() { return CheckedCount(0); }
+    static CheckedCount one() { return CheckedCount(1); }
+    static CheckedCount infinite() { return CheckedCount(kInfinite); }
+
+    bool is_zero() const { return v_ == 0; }
+    bool is_infinite() const { return v_ == kInfinite; }
+    bool saturated() const { return v_ == kSaturated; }
+
+    CheckedCount& operator+=(const CheckedCount& o) {
+        // A sum that lands on or past the sentinels is one of them: the
+        // larger of the operands if that already was one (infinity wins over
+        // saturation), otherwise saturation
+        U r;
+        if (__builtin_add_overflow(v_, o.v_, &r) || r >= kSaturated) {
+            r = std::max({v_, o.v_, kSaturated});
         }
+        v_ = r;
+        return *this;
+    }
+
+    friend CheckedCount operator*(CheckedCount a, CheckedCount b) {
+        if (a.is_zero() || b.is_zero()) return zero();
+        if (a.v_ >= kSaturated || b.v_ >= kSaturated) return CheckedCount(std::max(a.v_, b.v_));
+        U r;
+        if (__builtin_mul_overflow(a.v_, b.v_, &r) || r >= kSaturated) r = kSaturated;
+        return CheckedCount(r);
+    }
+
+    std::string str() const {
+        if (is_infinite()) return "infinite";
+        if (saturated()) return "overflow";
+        return to_decimal(v_);
+    }
+
+private:
+    static constexpr U kInfinite = ~U{0};
+    static constexpr U kSaturated = kInfinite - 1;
+
+    explicit CheckedCount(U v) : v_(v) {}
+
+    U v_ = 0;
+};
+
+using Count64 = CheckedCount<std::uint64_t>;
+using Count128 = CheckedCount<unsigned __int128>;
+
+// Arbitrary-precision count: little-endian base-2^32 limbs without leading
+// zero limbs, so zero has none. Never saturates.
+class BigCount {
+public:
+    BigCount() = default;
+    static BigCount zero() { return BigCount(); }
+    static BigCount one() { return from(1); }
+    static BigCount infinite() {
+        BigCount c;
+        c.infinite_ = true;
+        return c;
+    }
+    static BigCount from(std::uint64_t v) {
+        BigCount c;
+        for (; v != 0; v >>= 32) c.limbs_.push_back(static_cast<std::uint32_t>(v));
+        return c;
     }
 
-    int n = static_cast<int>(id.size());
-    std::vector<std::vector<int>> adj(n);
-    std::vector<std::vector<int>> rev(n);
+    bool is_zero() const { return !infinite_ && limbs_.empty(); }
+    bool is_infinite() const { return infinite_; }
+    bool saturated() const { return false; }
+    std::size_t heap_bytes() const { return limbs_.capacity() * sizeof(std::uint32_t); }
 
-    // Build adjacency lists (forward and reverse)
-    for (auto &p : raw) {
-        int u = get_id(p.first);
-        for (auto &to : p.second) {
-            int v = get_id(to);
-            adj[u].push_back(v);
-            rev[v].push_back(u);
+    BigCount& operator+=(const BigCount& o) {
+        if (infinite_ || o.infinite_) {
+            *this = infinite();
+            return *this;
         }
+        if (limbs_.size() < o.limbs_.size()) limbs_.resize(o.limbs_.size(), 0);
+        std::uint64_t carry = 0;
+        for (std::size_t i = 0; i < limbs_.size(); ++i) {
+            carry += limbs_[i];
+            if (i < o.limbs_.size()) carry += o.limbs_[i];
+            limbs_[i] = static_cast<std::uint32_t>(carry);
+            carry >>= 32;
+        }
+        if (carry) limbs_.push_back(static_cast<std::uint32_t>(carry));
+        return *this;
     }
 
-    // Look up important nodes
-    auto get_optional = [&](const char* name) -> int {
-        auto it = id.find(name);
-        if (it == id.end()) return -1;
-        return it->second;
-    };
+    friend BigCount operator*(const BigCount& a, const BigCount& b) {
+        if (a.is_zero() || b.is_zero()) return zero();
+        if (a.infinite_ || b.infinite_) return infinite();
+        BigCount r;
+        r.limbs_.assign(a.limbs_.size() + b.limbs_.size(), 0);
+        for (std::size_t i = 0; i < a.limbs_.size(); ++i) {
+            std::uint64_t carry = 0;
+            for (std::size_t j = 0; j < b.limbs_.size(); ++j) {
+                std::uint64_t cur = std::uint64_t{a.limbs_[i]} * b.limbs_[j] +
+                                    r.limbs_[i + j] + carry;
+                r.limbs_[i + j] = static_cast<std::uint32_t>(cur);
+                carry = cur >> 32;
+            }
+            r.limbs_[i + b.limbs_.size()] = static_cast<std::uint32_t>(carry);
+        }
+        while (!r.limbs_.empty() && r.limbs_.back() == 0) r.limbs_.pop_back();
+        return r;
+    }
 
-    int you = get_optional("you");
-    int svr = get_optional("svr");
-    int out = get_optional("out");
-    int dac = get_optional("dac");
-    int fft = get_optional("fft");
+    std::string str() const {
+        if (infinite_) return "infinite";
+        if (limbs_.empty()) return "0";
+        // Peel off nine decimal digits at a time
+        std::vector<std::uint32_t> rest = limbs_;
+        std::vector<std::uint32_t> chunks;
+        while (!rest.empty()) {
+            std::uint64_t rem = 0;
+            for (std::size_t i = rest.size(); i-- > 0;) {
+                std::uint64_t cur = (rem << 32) | rest[i];
+                rest[i] = static_cast<std::uint32_t>(cur / 1000000000);
+                rem = cur % 1000000000;
+            }
+            while (!rest.empty() && rest.back() == 0) rest.pop_back();
+            chunks.push_back(static_cast<std::uint32_t>(rem));
+        }
+        std::string s = std::to_string(chunks.back());
+        for (std::size_t i = chunks.size() - 1; i-- > 0;) {
+            std::string part = std::to_string(chunks[i]);
+            s += std::string(9 - part.size(), '0') + part;
+        }
+        return s;
+    }
 
-    if (out == -1) {
-        std::cerr << "Error: no 'out' node in input\n";
-        return 1;
+private:
+    std::vector<std::uint32_t> limbs_;
+    bool infinite_ = false;
+};
+
+// Primes just under 2^31 for CrtCount; their product is about 2^248.
+constexpr std::array<std::uint32_t, 8> kCrtPrimes = {
+    2147483647u, 2147483629u, 2147483587u, 2147483579u,
+    2147483563u, 2147483549u, 2147483543u, 2147483497u};
+
+// Count kept as residues modulo kCrtPrimes, so each operation is a fixed
+// handful of 64-bit multiplies whatever the size of the count. Exact for
+// counts below the product of the primes, rebuilt by Garner's algorithm
+// when printed. Nothing flags a count beyond that range, which is why this
+// is a cross-check for the other types rather than their fallback.
+class CrtCount {
+public:
+    CrtCount() = default;
+    static CrtCount zero() { return CrtCount(); }
+    static CrtCount one() {
+        CrtCount c;
+        c.r_.fill(1);
+        return c;
+    }
+    static CrtCount infinite() {
+        CrtCount c;
+        c.infinite_ = true;
+        return c;
     }
 
-    // Common helper: paths_to_out(u)
-    std::vector<long long> memo_to_out(n, -1);
+    bool is_zero() const {
+        return !infinite_ && std::all_of(r_.begin(), r_.end(), [](std::uint32_t x) { return x == 0; });
+    }
+    bool is_infinite() const { return infinite_; }
+    bool saturated() const { return false; }
 
-    std::function<long long(int)> paths_to_out = [&](int u) -> long long {
-        if (u == out) return 1;  // exactly one path: already at 'out'
-        long long &memo_val = memo_to_out[u];
-        if (memo_val != -1) return memo_val;
+    CrtCount& operator+=(const CrtCount& o) {
+        infinite_ |= o.infinite_;
+        for (std::size_t k = 0; k < r_.size(); ++k) {
+            std::uint64_t sum = std::uint64_t{r_[k]} + o.r_[k];
+            r_[k] = static_cast<std::uint32_t>(sum >= kCrtPrimes[k] ? sum - kCrtPrimes[k] : sum);
+        }
+        return *this;
+    }
 
-        long long total = 0;
-        for (int v : adj[u]) {
-            total += paths_to_out(v);
+    friend CrtCount operator*(const CrtCount& a, const CrtCount& b) {
+        if (a.is_zero() || b.is_zero()) return zero();
+        if (a.infinite_ || b.infinite_) return infinite();
+        CrtCount c;
+        for (std::size_t k = 0; k < c.r_.size(); ++k) {
+            c.r_[k] = static_cast<std::uint32_t>(std::uint64_t{a.r_[k]} * b.r_[k] % kCrtPrimes[k]);
         }
-        memo_val = total;
-        return total;
-    };
+        return c;
+    }
 
-    // Part 1: paths from "you" to "out"
-    if (you != -1) {
-        long long part1 = paths_to_out(you);
-        std::cout << "Part 1 (paths from you to out): " << part1 << "\n";
-    } else {
-        std::cout << "Part 1 (paths from you to out): (no 'you' node in this input)\n";
+    std::string str() const {
+        if (infinite_) return "infinite";
+        // Mixed-radix digits x = d0 + d1 p0 + d2 p0 p1 + ...
+        std::array<std::uint64_t, kCrtPrimes.size()> d{};
+        for (std::size_t k = 0; k < d.size(); ++k) {
+            const std::uint64_t p = kCrtPrimes[k];
+            std::uint64_t x = r_[k];
+            std::uint64_t radix = 1;
+            std::uint64_t prefix = 0; // d0 + d1 p0 + ... mod p
+            for (std::size_t j = 0; j < k; ++j) {
+                prefix = (prefix + d[j] % p * radix) % p;
+                radix = radix * (kCrtPrimes[j] % p) % p;
+            }
+            d[k] = (x + p - prefix) % p * inverse(radix, p) % p;
+        }
+        BigCount value;
+        for (std::size_t k = d.size(); k-- > 0;) {
+            value = value * BigCount::from(kCrtPrimes[k]);
+            value += BigCount::from(d[k]);
+        }
+        return value.str();
+    }
+
+private:
+    static std::uint64_t inverse(std::uint64_t a, std::uint64_t p) {
+        // Fermat: a^(p-2) mod p
+        std::uint64_t result = 1;
+        for (std::uint64_t e = p - 2; e; e >>= 1) {
+            if (e & 1) result = result * a % p;
+            a = a * a % p;
+        }
+        return result;
     }
 
-    // Helper: paths_from_svr(u) via reverse graph
-    std::vector<long long> memo_from_svr(n, -1);
+    std::array<std::uint32_t, kCrtPrimes.size()> r_{};
+    bool infinite_ = false;
+};
 
-    std::function<long long(int)> paths_from_svr = [&](int u) -> long long {
-        if (svr == -1) return 0;    // no svr in input
-        if (u == svr) return 1;     // exactly one path: svr to itself
-        long long &memo_val = memo_from_svr[u];
-        if (memo_val != -1) return memo_val;
+// A count a cyclic component can get to is unbounded.
+template <class Count>
+Count through(const Graph& g, int c, const Count& ways) {
+    return g.cyclic[c] && !ways.is_zero() ? Count::infinite() : ways;
+}
 
-        long long total = 0;
-        // In reversed graph, edges go "backwards".
-        // Paths from svr -> u (forward) == paths from u -> svr (in rev graph).
-        for (int p : rev[u]) {
-            total += paths_from_svr(p);
+// Number of paths from every node to target, by one sweep over the
+// topological order from the back: a node's count is the sum over its
+// successors, which all come later in the order.
+template <class Count>
+std::vector<Count> paths_to(const Graph& g, int target) {
+    std::vector<Count> ways(g.out.size(), Count::zero());
+    ways[target] = through(g, target, Count::one());
+    for (int i = g.position[target] - 1; i >= 0; --i) {
+        int u = g.order[i];
+        Count total = Count::zero();
+        for (const int* v = g.out.begin(u); v != g.out.end(u); ++v) {
+            total += ways[*v];
         }
-        memo_val = total;
-        return total;
-    };
+        ways[u] = through(g, u, total);
+    }
+    return ways;
+}
+
+// Number of paths from source to target. Only the nodes between the two in
+// the topological order can lie on such a path, so the sweep is limited to
+// that stretch, and it is empty when target comes before source. scratch is
+// indexed by node and left dirty only within that stretch.
+template <class Count>
+Count count_paths_between(const Graph& g, int source, int target, std::vector<Count>& scratch) {
+    if (source == -1 || target == -1) return Count::zero();
+    const int lo = g.position[source];
+    const int hi = g.position[target];
+    if (lo > hi) return Count::zero();
+    scratch.resize(g.out.size());
+
+    scratch[target] = through(g, target, Count::one());
+    for (int i = hi - 1; i >= lo; --i) {
+        int u = g.order[i];
+        Count total = Count::zero();
+        for (const int* v = g.out.begin(u); v != g.out.end(u); ++v) {
+            // Successors past target cannot reach it
+            if (g.position[*v] <= hi) total += scratch[*v];
+        }
+        scratch[u] = through(g, u, total);
+    }
+    return scratch[source];
+}
 
-    // Helper: count paths between two nodes (source -> target)
-    auto count_paths_between = [&](int source, int target) -> long long {
-        if (source == -1 || target == -1) return 0;
-        std::vector<long long> memo(n, -1);
+// Number of paths from source to target that visit every node of
+// waypoints. In a DAG a path meets its nodes in topological order, so of
+// the |W|! orders in which the waypoints could be visited only the one
+// sorted by position can occur, and the count factors into the path counts
+// between consecutive nodes of source, w1 .. wk, target. Those stretches of
+// the order do not overlap, so all of it costs at most one sweep from source
+// to target.
+template <class Count>
+Count count_paths_via(const Graph& g, int source, int target, std::vector<int> waypoints,
+                      std::vector<Count>& scratch) {
+    if (source == -1 || target == -1) return Count::zero();
+    std::sort(waypoints.begin(), waypoints.end(),
+              [&](int a, int b) { return g.position[a] < g.position[b]; });
+    waypoints.erase(std::unique(waypoints.begin(), waypoints.end()), waypoints.end());
+    waypoints.push_back(target);
 
-        std::function<long long(int)> dfs_between = [&](int u) -> long long {
-            if (u == target) return 1;
-            long long &mv = memo[u];
-            if (mv != -1) return mv;
+    Count total = Count::one();
+    int from = source;
+    for (int w : waypoints) {
+        total = total * count_paths_between(g, from, w, scratch);
+        if (total.is_zero()) break;
+        from = w;
+    }
+    return total;
+}
+
+// Largest table, in bytes, the bitmask DP allocates, and most waypoints it
+// takes on.
+constexpr int kMaxMaskWaypoints = 16;
+constexpr std::size_t kMaxMaskBytes = std::size_t{1} << 30;
 
-            long long total = 0;
-            for (int v : adj[u]) {
-                total += dfs_between(v);
+// Cross-check for count_paths_via that does not rely on the ordering
+// argument: one forward sweep from source to target in which every node
+// carries a path count per subset of waypoints visited so far. Linear in
+// the stretch times 2^|W|. Returns false, leaving result alone, if the
+// table would exceed kMaxMaskBytes.
+template <class Count>
+bool count_paths_via_mask(const Graph& g, int source, int target,
+                          const std::vector<int>& waypoints, Count& result) {
+    result = Count::zero();
+    if (source == -1 || target == -1) return true;
+    const int lo = g.position[source];
+    const int hi = g.position[target];
+    if (lo > hi) return true;
+    const std::size_t span = static_cast<std::size_t>(hi - lo) + 1;
+    const std::size_t width = std::size_t{1} << waypoints.size();
+    if (span * width > kMaxMaskBytes / sizeof(Count)) return false;
+
+    // Waypoint bits by position within the stretch; ones outside it can
+    // never be reached, and the full set is then out of reach as well
+    std::vector<std::uint32_t> bit(span, 0);
+    std::uint32_t full = 0;
+    for (std::size_t b = 0; b < waypoints.size(); ++b) {
+        int p = g.position[waypoints[b]];
+        if (p < lo || p > hi) return true;
+        bit[p - lo] |= std::uint32_t{1} << b;
+        full |= std::uint32_t{1} << b;
+    }
+
+    std::vector<Count> ways(span * width, Count::zero());
+    ways[bit[0]] = Count::one();
+    for (int i = lo; i <= hi; ++i) {
+        Count* row = &ways[(i - lo) * width];
+        int u = g.order[i];
+        for (std::size_t mask = 0; mask < width; ++mask) {
+            row[mask] = through(g, u, row[mask]);
+        }
+        if (i == hi) break;
+        for (const int* v = g.out.begin(u); v != g.out.end(u); ++v) {
+            int pv = g.position[*v];
+            if (pv > hi) continue;
+            Count* next = &ways[(pv - lo) * width];
+            for (std::size_t mask = 0; mask < width; ++mask) {
+                if (!row[mask].is_zero()) next[mask | bit[pv - lo]] += row[mask];
             }
-            mv = total;
+        }
+    }
+    result = ways[(hi - lo) * width + full];
+    return true;
+}
+
+// Number of paths from source to every node, by one forward sweep: each
+// node passes its count on to its successors. Nodes before source in the
+// topological order cannot be reached and stay at 0.
+template <class Count>
+std::vector<Count> paths_from(const Graph& g, int source) {
+    std::vector<Count> ways(g.out.size(), Count::zero());
+    ways[source] = Count::one();
+    for (int i = g.position[source]; i < g.out.size(); ++i) {
+        int u = g.order[i];
+        if (ways[u].is_zero()) continue;
+        ways[u] = through(g, u, ways[u]);
+        for (const int* v = g.out.begin(u); v != g.out.end(u); ++v) {
+            ways[*v] += ways[u];
+        }
+    }
+    return ways;
+}
+
+// Per-endpoint path count vectors (paths_to a target or paths_from a
+// source), kept in least-recently-used order under a byte budget so that
+// queries arriving in later batches can reuse the sweeps of earlier ones.
+// The most recent vector is always kept, even if it alone is over budget.
+template <class Count>
+class SweepCache {
+public:
+    SweepCache(const Graph& g, std::size_t budget_bytes) : g_(g), budget_(budget_bytes) {}
+
+    // Path counts to node (towards) or from node, computed on a miss.
+    const std::vector<Count>& get(int node, bool towards) {
+        const long long key = 2LL * node + (towards ? 1 : 0);
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return it->second->second;
+        }
+        lru_.emplace_front(key, towards ? paths_to<Count>(g_, node) : paths_from<Count>(g_, node));
+        index_[key] = lru_.begin();
+        used_ += bytes(lru_.front().second);
+        while (used_ > budget_ && lru_.size() > 1) {
+            used_ -= bytes(lru_.back().second);
+            index_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+        return lru_.front().second;
+    }
+
+private:
+    static std::size_t bytes(const std::vector<Count>& v) {
+        if constexpr (!std::is_same_v<Count, BigCount>) {
+            return v.size() * sizeof(Count);
+        } else {
+            std::size_t total = 0;
+            for (const BigCount& c : v) total += sizeof(BigCount) + c.heap_bytes();
             return total;
+        }
+    }
+
+    const Graph& g_;
+    std::size_t budget_;
+    std::size_t used_ = 0;
+    std::list<std::pair<long long, std::vector<Count>>> lru_;
+    std::unordered_map<long long, typename decltype(lru_)::iterator> index_;
+};
+
+// Answers a batch of (source, target) path-count queries. The batch is
+// grouped by whichever endpoint has fewer distinct values, so one sweep per
+// distinct target (or source) answers every query that shares it. Queries
+// naming an unknown device (-1) get 0.
+template <class Count>
+std::vector<Count> answer_queries(const std::vector<std::pair<int, int>>& queries,
+                                  SweepCache<Count>& cache) {
+    std::vector<Count> answers(queries.size(), Count::zero());
+    std::vector<std::size_t> pending;
+    for (std::size_t q = 0; q < queries.size(); ++q) {
+        if (queries[q].first != -1 && queries[q].second != -1) pending.push_back(q);
+    }
+
+    auto distinct = [&](auto endpoint) {
+        std::vector<int> ends;
+        for (std::size_t q : pending) ends.push_back(endpoint(queries[q]));
+        std::sort(ends.begin(), ends.end());
+        return std::unique(ends.begin(), ends.end()) - ends.begin();
+    };
+    const bool by_target = distinct([](const auto& q) { return q.second; }) <=
+                           distinct([](const auto& q) { return q.first; });
+    auto key = [&](std::size_t q) { return by_target ? queries[q].second : queries[q].first; };
+    std::stable_sort(pending.begin(), pending.end(),
+                     [&](std::size_t a, std::size_t b) { return key(a) < key(b); });
+
+    for (std::size_t i = 0; i < pending.size();) {
+        const std::vector<Count>& ways = cache.get(key(pending[i]), by_target);
+        std::size_t j = i;
+        for (; j < pending.size() && key(pending[j]) == key(pending[i]); ++j) {
+            const auto& [source, target] = queries[pending[j]];
+            answers[pending[j]] = ways[by_target ? source : target];
+        }
+        i = j;
+    }
+    return answers;
+}
+
+// Queries read and answered together in --queries mode, and the default
+// budget for cached sweeps.
+constexpr std::size_t kQueryBatch = std::size_t{1} << 16;
+constexpr std::size_t kDefaultCacheMb = 256;
+
+// Batch mode: every line of the query file names a source and a target
+// device ("a b", an arrow between them is allowed); the path count of each
+// is printed as "a b count" ("infinite" if a loop makes it unbounded), in
+// file order. With widen, the answers of a batch that outgrow Count are
+// answered again together in BigCount. Returns false if the file cannot be
+// read.
+template <class Count>
+bool run_query_file(const char* path, const Graph& graph, const NameTable& id,
+                    std::size_t cache_mb, bool widen) {
+    std::ifstream in(path);
+    if (!in) return false;
+
+    SweepCache<Count> cache(graph, cache_mb << 20);
+    SweepCache<BigCount> wide(graph, cache_mb << 20);
+    std::vector<std::string> names;
+    std::vector<std::pair<int, int>> queries;
+    auto flush = [&] {
+        std::vector<Count> answers = answer_queries(queries, cache);
+        std::vector<std::string> shown(queries.size());
+        std::vector<std::size_t> saturated;
+        std::vector<std::pair<int, int>> again;
+        for (std::size_t q = 0; q < queries.size(); ++q) {
+            if (widen && answers[q].saturated()) {
+                saturated.push_back(q);
+                again.push_back(queries[q]);
+            } else {
+                shown[q] = answers[q].str();
+            }
+        }
+        if (!again.empty()) {
+            std::vector<BigCount> exact = answer_queries(again, wide);
+            for (std::size_t i = 0; i < saturated.size(); ++i) shown[saturated[i]] = exact[i].str();
+        }
+        for (std::size_t q = 0; q < queries.size(); ++q) {
+            std::cout << names[2 * q] << ' ' << names[2 * q + 1] << ' ' << shown[q] << '\n';
+        }
+        names.clear();
+        queries.clear();
+    };
+
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string_view rest = line;
+        std::string_view ends[2];
+        int found = 0;
+        while (found < 2) {
+            std::size_t b = rest.find_first_not_of(" \t\r");
+            if (b == std::string_view::npos) break;
+            std::size_t e = std::min(rest.find_first_of(" \t\r", b), rest.size());
+            std::string_view token = rest.substr(b, e - b);
+            rest.remove_prefix(e);
+            if (token != "->") ends[found++] = token;
+        }
+        if (found < 2) continue;
+        names.emplace_back(ends[0]);
+        names.emplace_back(ends[1]);
+        auto component = [&](std::string_view name) {
+            int v = id.find(name);
+            return v == -1 ? -1 : graph.component[v];
         };
+        queries.emplace_back(component(ends[0]), component(ends[1]));
+        if (queries.size() == kQueryBatch) flush();
+    }
+    flush();
+    return true;
+}
+
+// Both parts' counts in one count type, as printed.
+struct Answers {
+    std::string part1;
+    std::string part2;
+    bool part1_infinite = false;
+    bool part2_infinite = false;
+    bool saturated = false;       // some count outgrew the type
+    bool too_many_states = false; // --mask could not run
+};
+
+// Part 1 counts paths from you to out unless you is -1; Part 2 counts
+// paths from svr to out through via when part2 is set.
+template <class Count>
+Answers count_parts(const Graph& g, int you, int svr, int out, const std::vector<int>& via,
+                    bool part2, bool use_mask) {
+    Answers a;
+    std::vector<Count> scratch;
+    if (you != -1) {
+        Count ways = count_paths_between(g, you, out, scratch);
+        a.part1 = ways.str();
+        a.part1_infinite = ways.is_infinite();
+        a.saturated |= ways.saturated();
+    }
+    if (part2) {
+        Count ways;
+        if (!use_mask) {
+            ways = count_paths_via(g, svr, out, via, scratch);
+        } else if (!count_paths_via_mask(g, svr, out, via, ways)) {
+            a.too_many_states = true;
+            return a;
+        }
+        a.part2 = ways.str();
+        a.part2_infinite = ways.is_infinite();
+        a.saturated |= ways.saturated();
+    }
+    return a;
+}
+
+// Tells on stderr which feedback loops make the count of paths from source
+// to target unbounded: the cyclic components that source reaches and that
+// reach target. Components marked in `reported` are skipped, and the ones
+// told about are marked, so a loop shared by several stretches of a path is
+// named once.
+void report_loops(const Graph& g, const NameTable& id, int source, int target,
+                  const std::string& what, std::vector<char>& reported) {
+    const std::vector<Count64> from = paths_from<Count64>(g, source);
+    const std::vector<Count64> to = paths_to<Count64>(g, target);
+    constexpr std::size_t kShown = 8;
+    for (int c = 0; c < g.out.size(); ++c) {
+        if (!g.cyclic[c] || reported[c] || from[c].is_zero() || to[c].is_zero()) continue;
+        reported[c] = 1;
+        const std::vector<int>& devices = g.members[c];
+        std::cerr << "Warning: " << what << " is infinite, loop through ";
+        for (std::size_t i = 0; i < devices.size() && i < kShown; ++i) {
+            std::cerr << (i ? ", " : "") << id.name(devices[i]);
+        }
+        if (devices.size() > kShown) std::cerr << ", ...";
+        std::cerr << " (" << devices.size() << (devices.size() == 1 ? " device)\n" : " devices)\n");
+    }
+}
+
+// Count type chosen with --count. Auto counts in checked 64 bits and moves
+// to 128 bits, then to BigCount, only if a count outgrows the type.
+enum class CountType { Auto, Bits64, Bits128, Big, Crt };
 
-        return dfs_between(source);
+int main(int argc, char* argv[]) {
+    // --via a,b,... replaces the Part 2 waypoints, --mask counts them with
+    // the subset DP instead of the ordering decomposition. --queries FILE
+    // answers the file's source/target pairs instead of the puzzle, keeping
+    // up to --cache-mb MB of sweeps between batches. --count 64, 128, big or
+    // crt fixes the count type instead of widening as needed. --profile
+    // prints per-phase hardware counters on stderr.
+    std::vector<std::string> via_names = {"dac", "fft"};
+    bool use_mask = false;
+    bool profile = false;
+    CountType count_type = CountType::Auto;
+    const char* query_file = nullptr;
+    std::size_t cache_mb = kDefaultCacheMb;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--via") == 0 && i + 1 < argc) {
+            via_names.clear();
+            std::string_view list = argv[++i];
+            while (!list.empty()) {
+                std::size_t comma = std::min(list.find(','), list.size());
+                if (comma > 0) via_names.emplace_back(list.substr(0, comma));
+                list.remove_prefix(std::min(comma + 1, list.size()));
+            }
+        } else if (std::strcmp(argv[i], "--mask") == 0) {
+            use_mask = true;
+        } else if (std::strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+        } else if (std::strcmp(argv[i], "--queries") == 0 && i + 1 < argc) {
+            query_file = argv[++i];
+        } else if (std::strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc) {
+            cache_mb = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            std::string_view type = argv[++i];
+            if (type == "64") {
+                count_type = CountType::Bits64;
+            } else if (type == "128") {
+                count_type = CountType::Bits128;
+            } else if (type == "big") {
+                count_type = CountType::Big;
+            } else if (type == "crt") {
+                count_type = CountType::Crt;
+            } else if (type != "auto") {
+                std::cerr << "Error: --count takes auto, 64, 128, big or crt\n";
+                return 1;
+            }
+        }
+    }
+
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
+
+    PhaseProfiler profiler(profile);
+
+    profiler.phase("parse");
+    std::ifstream in("input.txt", std::ios::binary);
+    if (!in) {
+        std::cerr << "Error: could not open input.txt\n";
+        return 1;
+    }
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    // One pass over "src: a b c" lines, straight into (from, to) index pairs
+    NameTable id;
+    std::vector<std::pair<int, int>> edges;
+    auto is_space = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    for (std::size_t pos = 0; pos < text.size();) {
+        std::size_t end = std::min(text.find('\n', pos), text.size());
+        std::string_view line(text.data() + pos, end - pos);
+        pos = end + 1;
+
+        // Find device name before ':'
+        std::size_t colonPos = line.find(':');
+        if (colonPos == std::string_view::npos) continue;
+
+        // trim spaces on src
+        std::string_view src = line.substr(0, colonPos);
+        while (!src.empty() && is_space(src.back())) src.remove_suffix(1);
+        while (!src.empty() && is_space(src.front())) src.remove_prefix(1);
+        int u = id.intern(src);
+
+        // split rhs on spaces
+        std::string_view rhs = line.substr(colonPos + 1);
+        for (std::size_t i = 0; i < rhs.size();) {
+            if (is_space(rhs[i])) {
+                ++i;
+                continue;
+            }
+            std::size_t j = i;
+            while (j < rhs.size() && !is_space(rhs[j])) ++j;
+            edges.emplace_back(u, id.intern(rhs.substr(i, j - i)));
+            i = j;
+        }
+    }
+
+    // Feedback loops collapse into single (cyclic) components, and all
+    // counting runs on that acyclic condensation
+    profiler.phase("condense");
+    const Graph graph = condense(id.size(), edges);
+    auto find_component = [&](std::string_view name) {
+        int v = id.find(name);
+        return v == -1 ? -1 : graph.component[v];
     };
 
-    // Part 2: paths from svr to out that visit both dac and fft
-    long long part2 = 0;
+    if (query_file) {
+        profiler.phase("queries");
+        bool read = false;
+        switch (count_type) {
+        case CountType::Auto:
+            read = run_query_file<Count64>(query_file, graph, id, cache_mb, true);
+            break;
+        case CountType::Bits64:
+            read = run_query_file<Count64>(query_file, graph, id, cache_mb, false);
+            break;
+        case CountType::Bits128:
+            read = run_query_file<Count128>(query_file, graph, id, cache_mb, false);
+            break;
+        case CountType::Big:
+            read = run_query_file<BigCount>(query_file, graph, id, cache_mb, false);
+            break;
+        case CountType::Crt:
+            read = run_query_file<CrtCount>(query_file, graph, id, cache_mb, false);
+            break;
+        }
+        if (!read) {
+            std::cerr << "Error: could not open " << query_file << "\n";
+            return 1;
+        }
+        profiler.report();
+        return 0;
+    }
 
-    if (svr != -1 && dac != -1 && fft != -1) {
-        // Count pieces:
+    // Look up important nodes
+    int you = find_component("you");
+    int svr = find_component("svr");
+    int out = find_component("out");
 
-        // svr -> dac, svr -> fft  (using reverse graph)
-        long long svr_to_dac = paths_from_svr(dac);
-        long long svr_to_fft = paths_from_svr(fft);
+    if (out == -1) {
+        std::cerr << "Error: no 'out' node in input\n";
+        return 1;
+    }
 
-        // dac -> fft and fft -> dac
-        long long dac_to_fft = count_paths_between(dac, fft);
-        long long fft_to_dac = count_paths_between(fft, dac);
+    // Part 2 waypoints: dac and fft unless --via says otherwise
+    std::vector<int> via;
+    std::string missing = svr == -1 ? "svr" : "";
+    std::string listed;
+    for (std::size_t i = 0; i < via_names.size(); ++i) {
+        int w = find_component(via_names[i]);
+        if (w == -1) {
+            missing += (missing.empty() ? "" : "/") + via_names[i];
+        }
+        via.push_back(w);
+        listed += (i == 0 ? "" : i + 1 == via_names.size() ? " and " : ", ") + via_names[i];
+    }
+    if (missing.empty() && use_mask && via.size() > kMaxMaskWaypoints) {
+        std::cerr << "Error: --mask takes at most " << kMaxMaskWaypoints << " waypoints\n";
+        return 1;
+    }
 
-        // dac -> out and fft -> out (we already have paths_to_out)
-        long long dac_to_out = paths_to_out(dac);  // used via formula
-        long long fft_to_out = paths_to_out(fft);
+    // Part 1: paths from you to out. Part 2: paths from svr to out that
+    // visit every waypoint.
+    profiler.phase("count");
+    const bool part2 = missing.empty();
+    Answers answers;
+    switch (count_type) {
+    case CountType::Auto:
+        answers = count_parts<Count64>(graph, you, svr, out, via, part2, use_mask);
+        if (answers.saturated) {
+            answers = count_parts<Count128>(graph, you, svr, out, via, part2, use_mask);
+        }
+        if (answers.saturated) {
+            answers = count_parts<BigCount>(graph, you, svr, out, via, part2, use_mask);
+        }
+        break;
+    case CountType::Bits64:
+        answers = count_parts<Count64>(graph, you, svr, out, via, part2, use_mask);
+        break;
+    case CountType::Bits128:
+        answers = count_parts<Count128>(graph, you, svr, out, via, part2, use_mask);
+        break;
+    case CountType::Big:
+        answers = count_parts<BigCount>(graph, you, svr, out, via, part2, use_mask);
+        break;
+    case CountType::Crt:
+        answers = count_parts<CrtCount>(graph, you, svr, out, via, part2, use_mask);
+        break;
+    }
+    if (answers.too_many_states) {
+        std::cerr << "Error: too many states for --mask\n";
+        return 1;
+    }
 
-        // Total paths S -> A-> B -> O + S -> B -> A -> O
-        // = svr_to_dac * dac_to_fft * fft_to_out
-        // + svr_to_fft * fft_to_dac * dac_to_out
-        part2 = svr_to_dac * dac_to_fft * fft_to_out
-              + svr_to_fft * fft_to_dac * dac_to_out;
+    if (you != -1) {
+        std::cout << "Part 1 (paths from you to out): " << answers.part1 << "\n";
+        if (answers.part1_infinite) {
+            std::vector<char> reported(graph.out.size(), 0);
+            report_loops(graph, id, you, out, "Part 1", reported);
+        }
+    } else {
+        std::cout << "Part 1 (paths from you to out): (no 'you' node in this input)\n";
+    }
 
-        std::cout << "Part 2 (paths from svr to out visiting dac and fft): "
-                  << part2 << "\n";
+    if (!part2) {
+        std::cout << "Part 2: missing " << missing << " in this input, cannot compute.\n";
     } else {
-        std::cout << "Part 2: missing svr/dac/fft in this input, cannot compute.\n";
+        std::cout << "Part 2 (paths from svr to out visiting " << listed << "): "
+                  << answers.part2 << "\n";
+        if (answers.part2_infinite) {
+            // Stretch by stretch, in the order the waypoints must be met
+            std::sort(via.begin(), via.end(),
+                      [&](int a, int b) { return graph.position[a] < graph.position[b]; });
+            int from = svr;
+            via.push_back(out);
+            std::vector<char> reported(graph.out.size(), 0);
+            for (int w : via) {
+                report_loops(graph, id, from, w, "Part 2", reported);
+                from = w;
+            }
+        }
     }
 
+    profiler.report();
     return 0;
-}
\ No newline at end of file
+}